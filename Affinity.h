@@ -0,0 +1,312 @@
+/*
+ * File Name       :Affinity.h
+ * Description     :Pinning of the nodes (MPI processes) & their threads to cores
+ * Author          :Karthik Rao
+ * Version         :0.1
+ *
+ * --affinity <Layout> pins every node of a host to one core of the cores the
+ * process is allowed to run on :
+ *
+ * compact : consecutive local ranks on consecutive cores of the same socket
+ * scatter : consecutive local ranks alternate between the sockets
+ * master  : like compact, but the master gets a core for itself and the slaves
+ *           of its host share the remaining cores
+ *
+ * A node is bound right after parsing the arguments, before any buffer is
+ * allocated, so that the pages of the per node buffers are first touched (and
+ * therefore placed) on the NUMA node of the core. AffinityReport() prints the
+ * actual binding of every node at startup.
+ *
+ * With the threads backend (--threads) the nodes are threads of one process,
+ * AffinityOrderThreads() orders the cores of the process once & every thread
+ * then pins itself with AffinityBindThread(), in the same layouts, once it has
+ * parsed the job. Only the buffers of the job, allocated by the thread after
+ * that, are first touched on its core : the node structures & the message
+ * queues are shared, they are allocated beforehand by the calling thread.
+ */
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <mpi.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "CommonHeader.h"
+
+#define AFFINITY_NONE       0
+#define AFFINITY_COMPACT    1
+#define AFFINITY_SCATTER    2
+#define AFFINITY_MASTER     3
+
+/* max no of cores handled on a host */
+#define AFFINITY_MAX_CPUS   1024
+/* length of the binding description of a node */
+#define AFFINITY_DESC_LEN   256
+
+typedef struct
+{
+    int Cpu;
+    int Package;
+    int Core;
+    /* position of the core within its package */
+    int PackageSlot;
+
+} AffinityCpuSt;
+
+/* cores this node may run on, ordered for the layout, filled in by AffinityBind() */
+static int AffinityCpus[AFFINITY_MAX_CPUS];
+static int AffinityNoOfCpus = 0;
+/* index of the first core of this node in AffinityCpus */
+static int AffinitySlot = 0;
+
+/*==============================================================================
+ *  AffinityParse
+ *=============================================================================*/
+
+static inline CStatus AffinityParse (const char * Arg, int * outLayout)
+{
+    if (strcmp (Arg, "compact") == 0) {
+        *outLayout = AFFINITY_COMPACT;
+    }else if (strcmp (Arg, "scatter") == 0) {
+        *outLayout = AFFINITY_SCATTER;
+    }else if (strcmp (Arg, "master") == 0) {
+        *outLayout = AFFINITY_MASTER;
+    }else if (strcmp (Arg, "none") == 0) {
+        *outLayout = AFFINITY_NONE;
+    }else {
+        return C_INVALID_ARGS;
+    }
+    return C_SUCCESS;
+}
+
+/*==============================================================================
+ *  AffinityReadTopology
+ *=============================================================================*/
+
+static inline int AffinityReadTopology (int Cpu, const char * Item)
+{
+    char Path[128];
+    FILE * File;
+    int Value = 0;
+
+    snprintf (Path, sizeof(Path), "/sys/devices/system/cpu/cpu%d/topology/%s", Cpu, Item);
+    File = fopen (Path, "r");
+    if (File != NULL) {
+        if (fscanf (File, "%d", &Value) != 1) {
+            Value = 0;
+        }
+        fclose (File);
+    }
+    return Value;
+}
+
+/*==============================================================================
+ *  AffinityOrderCpus
+ *=============================================================================*/
+
+/* order the allowed cores of this process for the given layout */
+static inline int AffinityOrderCpus (int Layout, int * outCpus)
+{
+    AffinityCpuSt Cpus[AFFINITY_MAX_CPUS];
+    cpu_set_t Mask;
+    int Cpu, NoOfCpus = 0, i;
+
+    if (sched_getaffinity (0, sizeof(Mask), &Mask) != 0) {
+        return 0;
+    }
+
+    for (Cpu = 0; Cpu < CPU_SETSIZE && NoOfCpus < AFFINITY_MAX_CPUS; Cpu++) {
+        if (CPU_ISSET (Cpu, &Mask)) {
+            Cpus[NoOfCpus].Cpu = Cpu;
+            Cpus[NoOfCpus].Package = AffinityReadTopology (Cpu, "physical_package_id");
+            Cpus[NoOfCpus].Core = AffinityReadTopology (Cpu, "core_id");
+            NoOfCpus++;
+        }
+    }
+
+    /* compact : socket by socket, core by core */
+    std::sort (Cpus, Cpus + NoOfCpus, [](const AffinityCpuSt & A, const AffinityCpuSt & B) {
+            if (A.Package != B.Package) return A.Package < B.Package;
+            if (A.Core != B.Core) return A.Core < B.Core;
+            return A.Cpu < B.Cpu;
+            });
+
+    if (Layout == AFFINITY_SCATTER) {
+        /* scatter : the n-th core of every socket, then the n+1-th ... */
+        for (i = 0; i < NoOfCpus; i++) {
+            Cpus[i].PackageSlot = (i > 0 && Cpus[i].Package == Cpus[i - 1].Package) ?
+                Cpus[i - 1].PackageSlot + 1 : 0;
+        }
+        std::stable_sort (Cpus, Cpus + NoOfCpus, [](const AffinityCpuSt & A, const AffinityCpuSt & B) {
+                return A.PackageSlot < B.PackageSlot;
+                });
+    }
+
+    for (i = 0; i < NoOfCpus; i++) {
+        outCpus[i] = Cpus[i].Cpu;
+    }
+    return NoOfCpus;
+}
+
+/*==============================================================================
+ *  AffinityBindCpu
+ *=============================================================================*/
+
+/* pin the calling thread to a single core */
+static inline CStatus AffinityBindCpu (int Cpu)
+{
+    cpu_set_t Mask;
+
+    CPU_ZERO (&Mask);
+    CPU_SET (Cpu, &Mask);
+    if (sched_setaffinity (0, sizeof(Mask), &Mask) != 0) {
+        return C_FAILURE;
+    }
+    return C_SUCCESS;
+}
+
+/*==============================================================================
+ *  AffinityBind
+ *=============================================================================*/
+
+/*
+ * collective over Comm. pins this node according to the layout, the master is
+ * rank MasterRank of Comm.
+ */
+static inline CStatus AffinityBind (int Layout, MPI_Comm Comm, int MasterRank)
+{
+    MPI_Comm LocalComm;
+    int ProcRank, LocalRank, LocalSize, MasterLocalRank, IsMaster;
+
+    if (Layout == AFFINITY_NONE) {
+        return C_SUCCESS;
+    }
+
+    MPI_Comm_rank (Comm, &ProcRank);
+    MPI_Comm_split_type (Comm, MPI_COMM_TYPE_SHARED, ProcRank, MPI_INFO_NULL, &LocalComm);
+    MPI_Comm_rank (LocalComm, &LocalRank);
+    MPI_Comm_size (LocalComm, &LocalSize);
+
+    /* local rank of the master if it runs on this host, -1 otherwise */
+    IsMaster = (ProcRank == MasterRank) ? LocalRank : -1;
+    MPI_Allreduce (&IsMaster, &MasterLocalRank, 1, MPI_INT, MPI_MAX, LocalComm);
+    MPI_Comm_free (&LocalComm);
+
+    AffinityNoOfCpus = AffinityOrderCpus (Layout, AffinityCpus);
+    if (AffinityNoOfCpus == 0) {
+        return C_FAILURE;
+    }
+
+    if (Layout == AFFINITY_MASTER && MasterLocalRank >= 0 && AffinityNoOfCpus > 1) {
+        if (ProcRank == MasterRank) {
+            AffinitySlot = 0;
+        }else {
+            /* the slaves of the master's host share the cores left by the master */
+            int SlaveRank = (LocalRank < MasterLocalRank) ? LocalRank : LocalRank - 1;
+            AffinitySlot = 1 + SlaveRank % (AffinityNoOfCpus - 1);
+        }
+    }else {
+        AffinitySlot = LocalRank % AffinityNoOfCpus;
+    }
+
+    DLOG (C_VERBOSE, "Node[%d] local rank %d of %d bound to cpu %d\n", ProcRank, LocalRank,
+            LocalSize, AffinityCpus[AffinitySlot]);
+
+    return AffinityBindCpu (AffinityCpus[AffinitySlot]);
+}
+
+/*==============================================================================
+ *  AffinityOrderThreads
+ *=============================================================================*/
+
+/* without MPI : the threads of this process are laid out over its cores, from the first one */
+static inline CStatus AffinityOrderThreads (int Layout)
+{
+    AffinityNoOfCpus = (Layout == AFFINITY_NONE) ? 0 : AffinityOrderCpus (Layout, AffinityCpus);
+    AffinitySlot = 0;
+    if (Layout != AFFINITY_NONE && AffinityNoOfCpus == 0) {
+        return C_FAILURE;
+    }
+    return C_SUCCESS;
+}
+
+/*==============================================================================
+ *  AffinityBindThread
+ *=============================================================================*/
+
+/*
+ * pin the calling thread ThreadNo of this node, the threads of a node take the
+ * cores following the core of the node. with the master layout, thread 0 is
+ * the master & keeps its core, the other threads share the remaining cores.
+ */
+static inline CStatus AffinityBindThread (int Layout, int ThreadNo)
+{
+    int Slot = AffinitySlot + ThreadNo;
+
+    if (AffinityNoOfCpus == 0) {
+        return C_SUCCESS;
+    }
+    if (Layout == AFFINITY_MASTER && ThreadNo > 0 && AffinityNoOfCpus > 1) {
+        Slot = AffinitySlot + 1 + (ThreadNo - 1) % (AffinityNoOfCpus - 1);
+    }
+    return AffinityBindCpu (AffinityCpus[Slot % AffinityNoOfCpus]);
+}
+
+/*==============================================================================
+ *  AffinityDescribe
+ *=============================================================================*/
+
+/* describe the binding of the calling thread in AFFINITY_DESC_LEN chars */
+static inline void AffinityDescribe (char * outDesc)
+{
+    char Host[64];
+    cpu_set_t Mask;
+    int Cpu, Len;
+
+    gethostname (Host, sizeof(Host));
+    Host[sizeof(Host) - 1] = '\0';
+    Len = snprintf (outDesc, AFFINITY_DESC_LEN, "%s running on cpu %d, allowed cpus", Host, sched_getcpu ());
+
+    if (sched_getaffinity (0, sizeof(Mask), &Mask) == 0) {
+        for (Cpu = 0; Cpu < CPU_SETSIZE && Len < AFFINITY_DESC_LEN - 8; Cpu++) {
+            if (CPU_ISSET (Cpu, &Mask)) {
+                Len += snprintf (outDesc + Len, AFFINITY_DESC_LEN - Len, " %d", Cpu);
+            }
+        }
+    }
+}
+
+/*==============================================================================
+ *  AffinityReport
+ *=============================================================================*/
+
+/* collective over Comm, Root prints the actual binding of every node */
+static inline void AffinityReport (MPI_Comm Comm, int Root, FILE * Out)
+{
+    char Desc[AFFINITY_DESC_LEN];
+    char * AllDesc = NULL;
+    int CommSize, ProcRank, Node;
+
+    MPI_Comm_size (Comm, &CommSize);
+    MPI_Comm_rank (Comm, &ProcRank);
+
+    AffinityDescribe (Desc);
+
+    if (ProcRank == Root) {
+        AllDesc = new char [CommSize * AFFINITY_DESC_LEN];
+    }
+    MPI_Gather (Desc, AFFINITY_DESC_LEN, MPI_CHAR, AllDesc, AFFINITY_DESC_LEN, MPI_CHAR, Root, Comm);
+
+    if (ProcRank == Root) {
+        for (Node = 0; Node < CommSize; Node++) {
+            fprintf (Out, "# affinity node %d : %s\n", Node, AllDesc + Node * AFFINITY_DESC_LEN);
+        }
+        fflush (Out);
+        delete[] AllDesc;
+    }
+}
+
+#endif /* AFFINITY_H */
@@ -0,0 +1,235 @@
+/*
+ * File Name       :CostOrder.h
+ * Description     :Largest-first dispatch order of the chunks of the dynamic
+ *                  schedulers, from a sampling pass over the range
+ * Author          :Karthik Rao
+ * Version         :0.1
+ *
+ * By default the master hands out the chunks in ascending index order, so
+ * when the expensive part of the integrand lies at the end of the range the
+ * most expensive chunks go out last & set the length of the tail. With
+ * --order lpt the chunks are handed out largest first (LPT, longest
+ * processing time first) :
+ *
+ * 1. the range served by the master is split into at most COST_ORDER_BUCKETS
+ *    buckets of whole chunks
+ * 2. before the first trial, every slave times a few points in every bucket,
+ *    COST_ORDER_SAMPLE_FRACTION of the range in all, the slaves probing
+ *    different points of a bucket
+ * 3. the master keeps the lowest time per point of every bucket, so that a
+ *    probe delayed by a preemption or by a slow slave does not make a bucket
+ *    look expensive, & sorts the buckets by decreasing cost, equal costs
+ *    keeping the index order
+ * 4. the chunks are handed out bucket by bucket in that order, & in index
+ *    order within a bucket
+ *
+ * The chunks are no longer handed out as a growing prefix of the range, so
+ * the end of the range is told by the no of points left, not by the position
+ * of a cursor. The chunks keep their boundaries at multiples of the chunk
+ * size from the start of the range, as the backup mode expects.
+ */
+#ifndef COSTORDER_H
+#define COSTORDER_H
+
+#include <string.h>
+#include <float.h>
+#include <chrono>
+#include <algorithm>
+
+#include "CommonHeader.h"
+#include "Integrand.h"
+
+#define DISPATCH_ORDER_INDEX        0
+#define DISPATCH_ORDER_LPT          1
+
+/* max no of buckets the cost is estimated for */
+#define COST_ORDER_BUCKETS          64
+/* fraction of the points evaluated by the sampling pass */
+#define COST_ORDER_SAMPLE_FRACTION  0.01
+
+typedef struct
+{
+    /* range served in this order, [FirstIndex, FirstIndex + NoOfPoints) */
+    long FirstIndex;
+    long NoOfPoints;
+    long Granularity;
+    int NoOfBuckets;
+    long BucketPoints;
+    /* lowest time per point of every bucket, valid at the master after the sampling pass */
+    double * Cost;
+    /* buckets by decreasing cost */
+    int * Order;
+    /* position in Order & next point of the current bucket */
+    int Current;
+    long NextIndex;
+    long PointsLeft;
+
+} CostOrderSt;
+/* Reference to cost order structure */
+typedef CostOrderSt * RefCostOrderSt;
+
+/*==============================================================================
+ *  CostOrderParse
+ *=============================================================================*/
+
+static inline CStatus CostOrderParse (const char * Arg, int * outOrder)
+{
+    if (strcmp (Arg, "index") == 0) {
+        *outOrder = DISPATCH_ORDER_INDEX;
+    }else if (strcmp (Arg, "lpt") == 0) {
+        *outOrder = DISPATCH_ORDER_LPT;
+    }else {
+        return C_INVALID_ARGS;
+    }
+    return C_SUCCESS;
+}
+
+/*==============================================================================
+ *  CostOrderInit
+ *=============================================================================*/
+
+static inline void CostOrderInit (RefCostOrderSt Order, long FirstIndex, long NoOfPoints, long Granularity)
+{
+    long NoOfChunks = (NoOfPoints + Granularity - 1) / Granularity;
+    long BucketChunks;
+    int Bucket;
+
+    Order->FirstIndex = FirstIndex;
+    Order->NoOfPoints = NoOfPoints;
+    Order->Granularity = Granularity;
+    BucketChunks = std::max (1L, (NoOfChunks + COST_ORDER_BUCKETS - 1) / COST_ORDER_BUCKETS);
+    Order->BucketPoints = BucketChunks * Granularity;
+    Order->NoOfBuckets = (int) std::max (1L, (NoOfChunks + BucketChunks - 1) / BucketChunks);
+    Order->Cost = new double [Order->NoOfBuckets];
+    Order->Order = new int [Order->NoOfBuckets];
+    for (Bucket = 0; Bucket < Order->NoOfBuckets; Bucket++) {
+        Order->Cost[Bucket] = 0;
+        Order->Order[Bucket] = Bucket;
+    }
+    Order->Current = 0;
+    Order->NextIndex = FirstIndex;
+    Order->PointsLeft = NoOfPoints;
+}
+
+/*==============================================================================
+ *  CostOrderFree
+ *=============================================================================*/
+
+static inline void CostOrderFree (RefCostOrderSt Order)
+{
+    delete[] Order->Cost;
+    delete[] Order->Order;
+    Order->Cost = NULL;
+    Order->Order = NULL;
+}
+
+/*==============================================================================
+ *  CostOrderBucket
+ *=============================================================================*/
+
+/* points [outStartIndex, outStopIndex) of a bucket */
+static inline void CostOrderBucket (RefCostOrderSt Order, int Bucket, long * outStartIndex, long * outStopIndex)
+{
+    *outStartIndex = Order->FirstIndex + Bucket * Order->BucketPoints;
+    *outStopIndex = std::min (*outStartIndex + Order->BucketPoints, Order->FirstIndex + Order->NoOfPoints);
+}
+
+/*==============================================================================
+ *  CostOrderProbe
+ *=============================================================================*/
+
+/*
+ * time the share of every bucket of slave Slave out of NoOfSlaves, the times
+ * per point of all the slaves are then combined with MIN at the master. a
+ * node which is not a slave (Slave < 0) gives DBL_MAX for every bucket.
+ */
+static inline void CostOrderProbe (RefCostOrderSt Order, int Slave, int NoOfSlaves,
+        const IntegrandSt * Integrands, int NoOfIntegrands, double LowerBound, double UpperBound,
+        long GridPoints, double * outTimes)
+{
+    int Bucket, k;
+    long StartIndex, StopIndex, ProbePoints, i;
+    double y = (UpperBound - LowerBound) / GridPoints;
+    /* keeps the probe from being optimised away */
+    volatile double Sink = 0;
+    std::chrono::steady_clock::time_point ProbeStart;
+
+    ProbePoints = std::max (1L, (long) (COST_ORDER_SAMPLE_FRACTION * Order->NoOfPoints /
+                (Order->NoOfBuckets * NoOfSlaves)));
+
+    for (Bucket = 0; Bucket < Order->NoOfBuckets; Bucket++) {
+        outTimes[Bucket] = DBL_MAX;
+        if (Slave < 0) {
+            continue;
+        }
+        /* the slaves probe evenly spaced parts of the bucket */
+        CostOrderBucket (Order, Bucket, &StartIndex, &StopIndex);
+        StartIndex += (StopIndex - StartIndex) * Slave / NoOfSlaves;
+        StopIndex = std::min (StopIndex, StartIndex + ProbePoints);
+        ProbeStart = std::chrono::steady_clock::now();
+        for (i = StartIndex; i < StopIndex; i++) {
+            for (k = 0; k < NoOfIntegrands; k++) {
+                Sink = Sink + Integrands[k].FuncToIntegrate (LowerBound + (i + 0.5) * y, Integrands[k].Intensity);
+            }
+        }
+        outTimes[Bucket] = std::chrono::duration<double>(std::chrono::steady_clock::now() - ProbeStart).count() /
+            std::max (1L, StopIndex - StartIndex);
+    }
+}
+
+/*==============================================================================
+ *  CostOrderSort
+ *=============================================================================*/
+
+/* at the master, once Cost holds the lowest time per point of every bucket */
+static inline void CostOrderSort (RefCostOrderSt Order)
+{
+    const double * Cost = Order->Cost;
+
+    std::stable_sort (Order->Order, Order->Order + Order->NoOfBuckets,
+            [Cost] (int a, int b) { return Cost[a] > Cost[b]; });
+    DLOG (C_VERBOSE, "Node[master] most expensive bucket %d, %.3g s per point\n",
+            Order->Order[0], Cost[Order->Order[0]]);
+}
+
+/*==============================================================================
+ *  CostOrderRewind
+ *=============================================================================*/
+
+static inline void CostOrderRewind (RefCostOrderSt Order)
+{
+    Order->Current = 0;
+    Order->NextIndex = Order->FirstIndex + Order->Order[0] * Order->BucketPoints;
+    Order->PointsLeft = Order->NoOfPoints;
+}
+
+/*==============================================================================
+ *  CostOrderDone
+ *=============================================================================*/
+
+static inline bool CostOrderDone (RefCostOrderSt Order)
+{
+    return (Order->PointsLeft == 0);
+}
+
+/*==============================================================================
+ *  CostOrderNext
+ *=============================================================================*/
+
+/* next chunk, the order must not be done */
+static inline void CostOrderNext (RefCostOrderSt Order, long * outStartIndex, long * outStopIndex)
+{
+    long BucketStart, BucketStop;
+
+    CostOrderBucket (Order, Order->Order[Order->Current], &BucketStart, &BucketStop);
+    *outStartIndex = Order->NextIndex;
+    *outStopIndex = std::min (Order->NextIndex + Order->Granularity, BucketStop);
+    Order->PointsLeft -= *outStopIndex - *outStartIndex;
+
+    Order->NextIndex = *outStopIndex;
+    if (Order->NextIndex == BucketStop && ++Order->Current < Order->NoOfBuckets) {
+        Order->NextIndex = Order->FirstIndex + Order->Order[Order->Current] * Order->BucketPoints;
+    }
+}
+
+#endif /* COSTORDER_H */
@@ -0,0 +1,277 @@
+/*
+ * File Name       :DecisionLog.h
+ * Description     :Binary log of the scheduling decisions of the master, used
+ *                  to replay the same assignment of chunks on a later run
+ * Author          :Karthik Rao
+ * Version         :0.1
+ *
+ * With --record <File>, the master logs every chunk it hands out : the chunk,
+ * the slave, the time it was sent & the time its result came back, relative
+ * to the start of the integration. The log of the last trial is kept.
+ *
+ * With --replay <File>, the master ignores the arrival order of the requests
+ * & hands every slave exactly the chunks of the log, in the same order. The
+ * no of nodes, the no of points & the static prefix must match the log.
+ * Copies of the speculative backup mode are logged but not replayed.
+ *
+ * The file is written in the byte order of the master :
+ *
+ * header : char Magic[8] "SCHEDLOG", int32 Version, int32 CommSize,
+ *          int64 NoOfPoints, int64 StaticPoints, int64 NoOfRecords
+ * record : int64 StartIndex, int64 StopIndex, int32 Node, int32 Flags,
+ *          double DispatchTime, double CompletionTime (-1 if never reported)
+ *
+ * sched_log prints a log as text along with a per slave summary.
+ */
+#ifndef DECISIONLOG_H
+#define DECISIONLOG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <chrono>
+#include <algorithm>
+
+#include "CommonHeader.h"
+
+#define DECISION_LOG_MAGIC      "SCHEDLOG"
+#define DECISION_LOG_VERSION    1
+/* initial no of records of a log, doubled when full */
+#define DECISION_LOG_CAPACITY   1024
+
+/* flags of a record */
+#define DECISION_BACKUP_COPY    1
+
+typedef struct
+{
+    char Magic[8];
+    int32_t Version;
+    int32_t CommSize;
+    int64_t NoOfPoints;
+    int64_t StaticPoints;
+    int64_t NoOfRecords;
+
+} DecisionHeaderSt;
+
+typedef struct
+{
+    int64_t StartIndex;
+    int64_t StopIndex;
+    int32_t Node;
+    int32_t Flags;
+    double DispatchTime;
+    double CompletionTime;
+
+} DecisionRecordSt;
+
+typedef struct
+{
+    DecisionHeaderSt Header;
+    DecisionRecordSt * Records;
+    long Capacity;
+    /* per node, first record of the node which may still be outstanding (recording)
+     * or which has not been handed out yet (replay) */
+    long * Cursor;
+    std::chrono::steady_clock::time_point StartTime;
+
+} DecisionLogSt;
+/* Reference to decision log structure */
+typedef DecisionLogSt * RefDecisionLogSt;
+
+/*==============================================================================
+ *  DecisionLogInit
+ *=============================================================================*/
+
+static inline void DecisionLogInit (RefDecisionLogSt Log, int CommSize, long NoOfPoints, long StaticPoints)
+{
+    memcpy (Log->Header.Magic, DECISION_LOG_MAGIC, sizeof(Log->Header.Magic));
+    Log->Header.Version = DECISION_LOG_VERSION;
+    Log->Header.CommSize = CommSize;
+    Log->Header.NoOfPoints = NoOfPoints;
+    Log->Header.StaticPoints = StaticPoints;
+    Log->Header.NoOfRecords = 0;
+    Log->Capacity = DECISION_LOG_CAPACITY;
+    Log->Records = (DecisionRecordSt *) malloc (Log->Capacity * sizeof(Log->Records[0]));
+    Log->Cursor = new long [CommSize];
+    memset (Log->Cursor, 0, CommSize * sizeof(Log->Cursor[0]));
+    Log->StartTime = std::chrono::steady_clock::now();
+}
+
+/*==============================================================================
+ *  DecisionLogFree
+ *=============================================================================*/
+
+static inline void DecisionLogFree (RefDecisionLogSt Log)
+{
+    free (Log->Records);
+    delete[] Log->Cursor;
+    Log->Records = NULL;
+    Log->Cursor = NULL;
+}
+
+/*==============================================================================
+ *  DecisionLogNow
+ *=============================================================================*/
+
+static inline double DecisionLogNow (RefDecisionLogSt Log)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - Log->StartTime).count();
+}
+
+/*==============================================================================
+ *  DecisionLogDispatched
+ *=============================================================================*/
+
+static inline void DecisionLogDispatched (RefDecisionLogSt Log, int Node, long StartIndex,
+        long StopIndex, int Flags)
+{
+    DecisionRecordSt * Record;
+
+    if (Log->Header.NoOfRecords == Log->Capacity) {
+        Log->Capacity *= 2;
+        Log->Records = (DecisionRecordSt *) realloc (Log->Records, Log->Capacity * sizeof(Log->Records[0]));
+    }
+    Record = &Log->Records[Log->Header.NoOfRecords++];
+    Record->StartIndex = StartIndex;
+    Record->StopIndex = StopIndex;
+    Record->Node = Node;
+    Record->Flags = Flags;
+    Record->DispatchTime = DecisionLogNow (Log);
+    Record->CompletionTime = -1;
+}
+
+/*==============================================================================
+ *  DecisionLogCompleted
+ *=============================================================================*/
+
+/* a slave reports its chunks in the order they were sent, the oldest outstanding one is done */
+static inline void DecisionLogCompleted (RefDecisionLogSt Log, int Node)
+{
+    long i;
+
+    for (i = Log->Cursor[Node]; i < Log->Header.NoOfRecords; i++) {
+        if (Log->Records[i].Node == Node && Log->Records[i].CompletionTime < 0) {
+            Log->Records[i].CompletionTime = DecisionLogNow (Log);
+            Log->Cursor[Node] = i + 1;
+            return;
+        }
+    }
+}
+
+/*==============================================================================
+ *  DecisionLogWrite
+ *=============================================================================*/
+
+static inline CStatus DecisionLogWrite (RefDecisionLogSt Log, const char * LogPath)
+{
+    FILE * LogFile;
+    size_t Written;
+
+    LogFile = fopen (LogPath, "wb");
+    if (LogFile == NULL) {
+        return C_FAILURE;
+    }
+    Written = fwrite (&Log->Header, sizeof(Log->Header), 1, LogFile);
+    Written += fwrite (Log->Records, sizeof(Log->Records[0]), Log->Header.NoOfRecords, LogFile);
+    fclose (LogFile);
+
+    return (Written == (size_t) (Log->Header.NoOfRecords + 1)) ? C_SUCCESS : C_FAILURE;
+}
+
+/*==============================================================================
+ *  DecisionLogRead
+ *=============================================================================*/
+
+/* read a whole log, the cursors are ready for a replay */
+static inline CStatus DecisionLogRead (RefDecisionLogSt Log, const char * LogPath)
+{
+    FILE * LogFile;
+    DecisionHeaderSt Header;
+    CStatus C_Status = C_SUCCESS;
+
+    LogFile = fopen (LogPath, "rb");
+    if (LogFile == NULL) {
+        return C_FAILURE;
+    }
+    if (fread (&Header, sizeof(Header), 1, LogFile) != 1 ||
+            memcmp (Header.Magic, DECISION_LOG_MAGIC, sizeof(Header.Magic)) != 0 ||
+            Header.Version != DECISION_LOG_VERSION || Header.CommSize < 1 || Header.NoOfRecords < 0) {
+        fclose (LogFile);
+        return C_INVALID_ARGS;
+    }
+
+    DecisionLogInit (Log, Header.CommSize, Header.NoOfPoints, Header.StaticPoints);
+    free (Log->Records);
+    Log->Capacity = std::max ((long) Header.NoOfRecords, 1L);
+    Log->Records = (DecisionRecordSt *) malloc (Log->Capacity * sizeof(Log->Records[0]));
+    Log->Header = Header;
+    if (fread (Log->Records, sizeof(Log->Records[0]), Header.NoOfRecords, LogFile) != (size_t) Header.NoOfRecords) {
+        DecisionLogFree (Log);
+        C_Status = C_INVALID_ARGS;
+    }
+    fclose (LogFile);
+
+    return C_Status;
+}
+
+/*==============================================================================
+ *  DecisionLogCheck
+ *=============================================================================*/
+
+/*
+ * check that a log can be replayed : same no of nodes & points, the chunks
+ * handed out by the master (not the backup copies) cover the range after the
+ * static prefix.
+ */
+static inline CStatus DecisionLogCheck (RefDecisionLogSt Log, int CommSize, long NoOfPoints)
+{
+    long i, Covered = 0;
+
+    if (Log->Header.CommSize != CommSize || Log->Header.NoOfPoints != NoOfPoints) {
+        return C_INVALID_ARGS;
+    }
+    for (i = 0; i < Log->Header.NoOfRecords; i++) {
+        if (Log->Records[i].Node < 1 || Log->Records[i].Node >= CommSize ||
+                Log->Records[i].StartIndex < 0 || Log->Records[i].StopIndex > NoOfPoints ||
+                Log->Records[i].StartIndex > Log->Records[i].StopIndex) {
+            return C_INVALID_ARGS;
+        }
+        if (!(Log->Records[i].Flags & DECISION_BACKUP_COPY)) {
+            Covered += Log->Records[i].StopIndex - Log->Records[i].StartIndex;
+        }
+    }
+    return (Covered == NoOfPoints - Log->Header.StaticPoints) ? C_SUCCESS : C_INVALID_ARGS;
+}
+
+/*==============================================================================
+ *  DecisionLogRewind
+ *=============================================================================*/
+
+static inline void DecisionLogRewind (RefDecisionLogSt Log)
+{
+    memset (Log->Cursor, 0, Log->Header.CommSize * sizeof(Log->Cursor[0]));
+}
+
+/*==============================================================================
+ *  DecisionLogNext
+ *=============================================================================*/
+
+/* next chunk of the log for Node, returns false once the node has had all its chunks */
+static inline bool DecisionLogNext (RefDecisionLogSt Log, int Node, long * outStartIndex, long * outStopIndex)
+{
+    long i;
+
+    for (i = Log->Cursor[Node]; i < Log->Header.NoOfRecords; i++) {
+        if (Log->Records[i].Node == Node && !(Log->Records[i].Flags & DECISION_BACKUP_COPY)) {
+            *outStartIndex = Log->Records[i].StartIndex;
+            *outStopIndex = Log->Records[i].StopIndex;
+            Log->Cursor[Node] = i + 1;
+            return true;
+        }
+    }
+    Log->Cursor[Node] = Log->Header.NoOfRecords;
+    return false;
+}
+
+#endif /* DECISIONLOG_H */
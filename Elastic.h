@@ -0,0 +1,326 @@
+/*
+ * File Name       :Elastic.h
+ * Description     :Workers spawned by the master of advnc_sched while a job
+ *                  runs, & retired again on request
+ * Author          :Karthik Rao
+ * Version         :0.1
+ *
+ * With --elastic <Workers>, the master may add up to <Workers> slaves to a
+ * running job. A worker is started with MPI_Comm_spawn on MPI_COMM_SELF, so
+ * the slaves already running are not involved, & the intercommunicator is
+ * merged into a communicator of two nodes : the master (rank 0) & the worker
+ * (rank 1). The worker runs the usual slave loop on it & sends its local sum
+ * with MPI_Reduce on it when it exits.
+ *
+ * The master numbers the workers after the slaves of the job, from CommSize
+ * on, & waits for the messages of all the communicators with MPI_Waitany.
+ *
+ * A worker is spawned when the points not handed out yet would take longer
+ * than --elastic-backlog seconds at the rate observed so far, at most once
+ * per ELASTIC_SPAWN_INTERVAL, or on SIGUSR1. SIGUSR2 retires the most recent
+ * worker : it is sent a quit instead of its next chunks, so it completes the
+ * chunks it holds before it exits. The signals are acted upon at the next
+ * message received by the master.
+ */
+#ifndef ELASTIC_H
+#define ELASTIC_H
+
+#include <mpi.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "CommonHeader.h"
+
+/* min time between two workers spawned because of the backlog, in s */
+#define ELASTIC_SPAWN_INTERVAL  1.0
+/* backlog above which a worker is spawned, unless given, in s */
+#define ELASTIC_BACKLOG         10.0
+/* first argument of a spawned worker, followed by the job */
+#define ELASTIC_WORKER_ARG      "--elastic-worker"
+/* no of arguments of the job passed to a spawned worker */
+#define ELASTIC_JOB_ARGS        5
+
+typedef struct
+{
+    /* max no of workers spawned during a run, 0 if disabled */
+    int MaxWorkers;
+    /* points left to be handed out, in s at the current rate, above which a worker is spawned */
+    double Backlog;
+
+} ElasticConfigSt;
+
+typedef struct
+{
+    int MaxWorkers;
+    double Backlog;
+    /* no of nodes of the job, the first worker is node CommSize */
+    int CommSize;
+    int NoOfWorkers;
+    /* per worker, the intercommunicator of the spawn & the merged one */
+    MPI_Comm * Inter;
+    MPI_Comm * Merged;
+    bool * Retiring;
+    /* pending receive of the job communicator (0) & of every worker (1 + worker) */
+    MPI_Request * RecvReq;
+    double * RecvBuffer;
+    int BufferLen;
+    /* no of slaves of the job which have exited */
+    int NoOfExited;
+    double LastSpawn;
+
+} ElasticSt;
+/* Reference to elastic structure */
+typedef ElasticSt * RefElasticSt;
+
+/* requests received by signal, counted until the master acts upon them */
+static volatile sig_atomic_t ElasticGrowRequests = 0;
+static volatile sig_atomic_t ElasticRetireRequests = 0;
+
+/*==============================================================================
+ *  ElasticSignal
+ *=============================================================================*/
+
+static inline void ElasticSignal (int Signal)
+{
+    if (Signal == SIGUSR1) {
+        ElasticGrowRequests++;
+    }else {
+        ElasticRetireRequests++;
+    }
+}
+
+/*==============================================================================
+ *  ElasticInstallSignals
+ *=============================================================================*/
+
+/* on every node, mpirun forwards SIGUSR1 & SIGUSR2 to all of them */
+static inline void ElasticInstallSignals (void)
+{
+    struct sigaction Action;
+
+    memset (&Action, 0, sizeof(Action));
+    Action.sa_handler = ElasticSignal;
+    sigemptyset (&Action.sa_mask);
+    Action.sa_flags = SA_RESTART;
+    sigaction (SIGUSR1, &Action, NULL);
+    sigaction (SIGUSR2, &Action, NULL);
+}
+
+/*==============================================================================
+ *  ElasticPost
+ *=============================================================================*/
+
+/* post the receive of the next message of a communicator, 0 being the one of the job */
+static inline void ElasticPost (RefElasticSt Elastic, MPI_Comm Comm, int Channel)
+{
+    MPI_Irecv (&Elastic->RecvBuffer[Channel * Elastic->BufferLen], Elastic->BufferLen, MPI_DOUBLE,
+            MPI_ANY_SOURCE, MPI_ANY_TAG, (Channel == 0) ? Comm : Elastic->Merged[Channel - 1],
+            &Elastic->RecvReq[Channel]);
+}
+
+/*==============================================================================
+ *  ElasticInit
+ *=============================================================================*/
+
+static inline void ElasticInit (RefElasticSt Elastic, const ElasticConfigSt * Config, MPI_Comm Comm,
+        int BufferLen)
+{
+    int Channel;
+
+    Elastic->MaxWorkers = Config->MaxWorkers;
+    Elastic->Backlog = Config->Backlog;
+    MPI_Comm_size (Comm, &Elastic->CommSize);
+    Elastic->NoOfWorkers = 0;
+    Elastic->Inter = new MPI_Comm [Elastic->MaxWorkers];
+    Elastic->Merged = new MPI_Comm [Elastic->MaxWorkers];
+    Elastic->Retiring = new bool [Elastic->MaxWorkers];
+    Elastic->RecvReq = new MPI_Request [Elastic->MaxWorkers + 1];
+    Elastic->BufferLen = BufferLen;
+    Elastic->RecvBuffer = new double [(Elastic->MaxWorkers + 1) * BufferLen];
+    for (Channel = 0; Channel <= Elastic->MaxWorkers; Channel++) {
+        Elastic->RecvReq[Channel] = MPI_REQUEST_NULL;
+    }
+    Elastic->NoOfExited = 0;
+    Elastic->LastSpawn = 0;
+    ElasticPost (Elastic, Comm, 0);
+}
+
+/*==============================================================================
+ *  ElasticFree
+ *=============================================================================*/
+
+static inline void ElasticFree (RefElasticSt Elastic)
+{
+    delete[] Elastic->Inter;
+    delete[] Elastic->Merged;
+    delete[] Elastic->Retiring;
+    delete[] Elastic->RecvReq;
+    delete[] Elastic->RecvBuffer;
+}
+
+/*==============================================================================
+ *  ElasticTarget
+ *=============================================================================*/
+
+/* communicator & rank to reach Node with */
+static inline MPI_Comm ElasticTarget (RefElasticSt Elastic, MPI_Comm Comm, int Node, int * outRank)
+{
+    if (Elastic->MaxWorkers == 0 || Node < Elastic->CommSize) {
+        *outRank = Node;
+        return Comm;
+    }
+    *outRank = 1;
+    return Elastic->Merged[Node - Elastic->CommSize];
+}
+
+/*==============================================================================
+ *  ElasticRecv
+ *=============================================================================*/
+
+/*
+ * wait for the next message of any slave or worker. a communicator stays
+ * posted until its last node has sent its exit message (ExitTag).
+ */
+static inline void ElasticRecv (RefElasticSt Elastic, MPI_Comm Comm, int ExitTag, int * outNode,
+        MPI_Status * outStatus)
+{
+    int Channel;
+
+    MPI_Waitany (Elastic->NoOfWorkers + 1, Elastic->RecvReq, &Channel, outStatus);
+
+    *outNode = (Channel == 0) ? outStatus->MPI_SOURCE : Elastic->CommSize + Channel - 1;
+    if (outStatus->MPI_TAG == ExitTag) {
+        if (Channel > 0 || ++Elastic->NoOfExited == Elastic->CommSize - 1) {
+            return;
+        }
+    }
+    ElasticPost (Elastic, Comm, Channel);
+}
+
+/*==============================================================================
+ *  ElasticWantWorker
+ *=============================================================================*/
+
+/*
+ * true if a worker should be spawned : on request, or if the points left at
+ * the rate observed after Elapsed s would take longer than the backlog
+ */
+static inline bool ElasticWantWorker (RefElasticSt Elastic, double Elapsed, long PointsLeft,
+        long PointsDone)
+{
+    if (Elastic->NoOfWorkers == Elastic->MaxWorkers || PointsLeft == 0) {
+        return false;
+    }
+    if (ElasticGrowRequests > 0) {
+        ElasticGrowRequests--;
+        return true;
+    }
+    return (PointsDone > 0 && Elapsed - Elastic->LastSpawn >= ELASTIC_SPAWN_INTERVAL &&
+            PointsLeft * (Elapsed / PointsDone) > Elastic->Backlog);
+}
+
+/*==============================================================================
+ *  ElasticSpawn
+ *=============================================================================*/
+
+/*
+ * start a worker running the job JobArgv ("<FunctionID> <LowerBound>
+ * <UpperBound> <NoOfPoints> <Intensity>") with the given prefetch depth.
+ * returns the node of the worker.
+ */
+static inline CStatus ElasticSpawn (RefElasticSt Elastic, MPI_Comm Comm, char * JobArgv[],
+        int PrefetchDepth, double Elapsed, int * outNode)
+{
+    char Program[PATH_MAX];
+    char Prefetch[16];
+    char * WorkerArgv[ELASTIC_JOB_ARGS + 8];
+    int Argc = 0, Arg, Worker = Elastic->NoOfWorkers;
+    ssize_t Len;
+
+    Len = readlink ("/proc/self/exe", Program, sizeof(Program) - 1);
+    if (Len <= 0) {
+        return C_FAILURE;
+    }
+    Program[Len] = '\0';
+    snprintf (Prefetch, sizeof(Prefetch), "%d", PrefetchDepth);
+    /* a failed spawn is not retried before the interval has passed either */
+    Elastic->LastSpawn = Elapsed;
+
+    /* the options are resolved by the master, the worker needs no collective call to parse them */
+    WorkerArgv[Argc++] = (char *) ELASTIC_WORKER_ARG;
+    for (Arg = 0; Arg < ELASTIC_JOB_ARGS; Arg++) {
+        WorkerArgv[Argc++] = JobArgv[Arg];
+    }
+    WorkerArgv[Argc++] = (char *) "--sched";
+    WorkerArgv[Argc++] = (char *) "advnc";
+    WorkerArgv[Argc++] = (char *) "--tuning";
+    WorkerArgv[Argc++] = (char *) "none";
+    WorkerArgv[Argc++] = (char *) "--prefetch";
+    WorkerArgv[Argc++] = Prefetch;
+    WorkerArgv[Argc] = NULL;
+
+    if (MPI_Comm_spawn (Program, WorkerArgv, 1, MPI_INFO_NULL, 0, MPI_COMM_SELF,
+                &Elastic->Inter[Worker], MPI_ERRCODES_IGNORE) != MPI_SUCCESS) {
+        return C_FAILURE;
+    }
+    MPI_Intercomm_merge (Elastic->Inter[Worker], 0, &Elastic->Merged[Worker]);
+
+    Elastic->Retiring[Worker] = false;
+    Elastic->NoOfWorkers++;
+    ElasticPost (Elastic, Comm, Worker + 1);
+    *outNode = Elastic->CommSize + Worker;
+
+    return C_SUCCESS;
+}
+
+/*==============================================================================
+ *  ElasticWantRetire
+ *=============================================================================*/
+
+/* on request, pick the most recent worker still running, returns false if there is none */
+static inline bool ElasticWantRetire (RefElasticSt Elastic, int * outNode)
+{
+    int Worker;
+
+    if (ElasticRetireRequests == 0) {
+        return false;
+    }
+    ElasticRetireRequests--;
+    for (Worker = Elastic->NoOfWorkers - 1; Worker >= 0; Worker--) {
+        if (!Elastic->Retiring[Worker] && Elastic->RecvReq[Worker + 1] != MPI_REQUEST_NULL) {
+            Elastic->Retiring[Worker] = true;
+            *outNode = Elastic->CommSize + Worker;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*==============================================================================
+ *  ElasticRetiring
+ *=============================================================================*/
+
+static inline bool ElasticRetiring (RefElasticSt Elastic, int Node)
+{
+    return (Elastic->MaxWorkers > 0 && Node >= Elastic->CommSize &&
+            Elastic->Retiring[Node - Elastic->CommSize]);
+}
+
+/*==============================================================================
+ *  ElasticRelease
+ *=============================================================================*/
+
+/* add the local sum of a worker which has exited to Integral & disconnect it */
+static inline void ElasticRelease (RefElasticSt Elastic, int Node, double * Integral, int Count)
+{
+    int Worker = Node - Elastic->CommSize;
+
+    MPI_Reduce (MPI_IN_PLACE, Integral, Count, MPI_DOUBLE, MPI_SUM, 0, Elastic->Merged[Worker]);
+    MPI_Comm_free (&Elastic->Merged[Worker]);
+    MPI_Comm_disconnect (&Elastic->Inter[Worker]);
+}
+
+#endif /* ELASTIC_H */
@@ -0,0 +1,150 @@
+/*
+ * File Name       :Integrand.h
+ * Description     :Integrand declarations shared by the static, master-worker
+ *                  and advanced master-worker schedulers
+ * Author          :Karthik Rao
+ * Version         :0.1
+ *
+ * A single run integrates a vector of K integrands over the same grid.
+ * The <FunctionID> and <Intensity> arguments accept a comma separated list,
+ * e.g.
+ *
+ * mpirun -n 3 ./advnc_sched 1,2,3,4 0 10 1000 1        (f1..f4, intensity 1)
+ * mpirun -n 3 ./advnc_sched 1 0 10 1000 1,10,100,1000  (f1 at 4 intensities)
+ * mpirun -n 3 ./advnc_sched 1,2 0 10 1000 10,100       (f1@10 and f2@100)
+ *
+ * A list of length 1 is broadcast against the other list, otherwise both
+ * lists must have the same length.
+ *
+ * FunctionID 1..4 are f1..f4 from libfunctions.a, 5..8 are the synthetic
+ * integrands of SyntheticFunctions.h.
+ */
+#ifndef INTEGRAND_H
+#define INTEGRAND_H
+
+#include <stdlib.h>
+
+#include "CommonHeader.h"
+#include "SyntheticFunctions.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    float f1(float x, int intensity);
+    float f2(float x, int intensity);
+    float f3(float x, int intensity);
+    float f4(float x, int intensity);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* function pointer to one of the following functions : f1, f2, f3, f4 or a synthetic one */
+typedef float (*Func) (float, int);
+
+/* max no of integrands which can be computed in a single pass over the grid */
+#define MAX_INTEGRANDS 16
+
+typedef struct
+{
+    int FunctionID;
+    int Intensity;
+    /* function pointer to one of the following functions : f1, f2, f3, f4 or a synthetic one */
+    Func FuncToIntegrate;
+
+} IntegrandSt;
+/* Reference to integrand structure */
+typedef IntegrandSt * RefIntegrandSt;
+
+
+/*==============================================================================
+ *  GetIntegrandFunc
+ *=============================================================================*/
+
+static inline Func GetIntegrandFunc (int FunctionID)
+{
+    /* based on the input argument, select suitable function to integrate */
+    switch (FunctionID)
+    {
+        case 1: return f1;
+        case 2: return f2;
+        case 3: return f3;
+        case 4: return f4;
+        case SYNTH_UNIFORM: return SynthUniform;
+        case SYNTH_LINEAR: return SynthLinear;
+        case SYNTH_SPIKES: return SynthSpikes;
+        case SYNTH_BIMODAL: return SynthBimodal;
+        default: return NULL;
+    }
+}
+
+/*==============================================================================
+ *  ParseIntList
+ *=============================================================================*/
+
+/* parse a comma separated list of integers, returns the no of values parsed */
+static inline int ParseIntList (const char * inStr, int * outList, int MaxCount)
+{
+    int Count = 0;
+    const char * Cur = inStr;
+    char * End;
+
+    while (*Cur != '\0') {
+        if (Count == MaxCount) {
+            return -1;
+        }
+        outList[Count++] = (int) strtol (Cur, &End, 10);
+        if (End == Cur) {
+            return -1;
+        }
+        Cur = End;
+        if (*Cur == ',') {
+            Cur++;
+        }else if (*Cur != '\0') {
+            return -1;
+        }
+    }
+
+    return Count;
+}
+
+/*==============================================================================
+ *  ParseIntegrands
+ *=============================================================================*/
+
+static inline CStatus ParseIntegrands (const char * FunctionArg, const char * IntensityArg,
+        IntegrandSt * outList, int * outCount)
+{
+    int FunctionIDs[MAX_INTEGRANDS];
+    int Intensities[MAX_INTEGRANDS];
+    int NoOfFunctions, NoOfIntensities, Count, k;
+
+    NoOfFunctions = ParseIntList (FunctionArg, FunctionIDs, MAX_INTEGRANDS);
+    NoOfIntensities = ParseIntList (IntensityArg, Intensities, MAX_INTEGRANDS);
+
+    if (NoOfFunctions <= 0 || NoOfIntensities <= 0) {
+        return C_INVALID_ARGS;
+    }
+    if (NoOfFunctions != 1 && NoOfIntensities != 1 && NoOfFunctions != NoOfIntensities) {
+        return C_INVALID_ARGS;
+    }
+
+    Count = (NoOfFunctions > NoOfIntensities) ? NoOfFunctions : NoOfIntensities;
+
+    for (k = 0; k < Count; k++) {
+        outList[k].FunctionID = FunctionIDs[(NoOfFunctions == 1) ? 0 : k];
+        outList[k].Intensity = Intensities[(NoOfIntensities == 1) ? 0 : k];
+        outList[k].FuncToIntegrate = GetIntegrandFunc (outList[k].FunctionID);
+
+        if (outList[k].FuncToIntegrate == NULL) {
+            return C_INVALID_ARGS;
+        }
+    }
+
+    *outCount = Count;
+
+    return C_SUCCESS;
+}
+
+#endif /* INTEGRAND_H */
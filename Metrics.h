@@ -0,0 +1,371 @@
+/*
+ * File Name       :Metrics.h
+ * Description     :Live progress & throughput metrics published by the master
+ * Author          :Karthik Rao
+ * Version         :0.1
+ *
+ * --metrics <Target> publishes a snapshot of the progress of the master every
+ * --metrics-interval <Seconds> (default 1) & once more at the end of the run.
+ * Target is either a file, rewritten atomically (write + rename) so that a
+ * reader never sees a partial snapshot, or unix:<SocketPath>, a UNIX domain
+ * socket listened on by the reader, which then gets a stream of snapshots.
+ * --metrics-format prom|json (default prom) selects the Prometheus text format
+ * or one JSON object per line.
+ *
+ * The completed points are the sizes of the chunks actually reported : the
+ * master keeps, for every slave, the sizes of the chunks sent to it & not yet
+ * reported, in the order they were sent, & the result of a slave belongs to
+ * the oldest one. A copy whose result is dropped (backup mode) only counts as
+ * a chunk back. With work stealing the chunks move between the slaves, so a
+ * slave rather reports the size of every chunk it has computed.
+ *
+ * The master only bumps a few atomic counters per message. A separate thread
+ * of the master process, which makes no MPI calls, turns them into rates &
+ * does the formatting & the I/O, so the dispatch loop is not slowed down.
+ */
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+
+#include "CommonHeader.h"
+
+#define METRICS_FORMAT_PROM  0
+#define METRICS_FORMAT_JSON  1
+
+/* length of a metric line */
+#define METRICS_LINE_LEN     256
+
+typedef struct
+{
+    /* NULL if disabled */
+    const char * Target;
+    double Interval;
+    int Format;
+
+} MetricsConfigSt;
+
+typedef struct
+{
+    MetricsConfigSt Config;
+    int NoOfNodes;
+    long TotalPoints;
+    /* updated by the master */
+    std::atomic<long> DispatchedChunks;
+    std::atomic<long> CompletedChunks;
+    std::atomic<long> CompletedPoints;
+    std::atomic<long> * NodePoints;
+    /* per node FIFO of the sizes of the outstanding chunks, NoOfNodes x MaxOutstanding */
+    int MaxOutstanding;
+    long * Outstanding;
+    int * Head;
+    int * Count;
+    /* time spent by the master waiting for a message, in ns */
+    std::atomic<long> IdleNanos;
+    std::chrono::steady_clock::time_point IdleStart;
+    /* owned by the publishing thread */
+    std::chrono::steady_clock::time_point StartTime, LastTime;
+    long LastPoints, LastIdleNanos;
+    long * LastNodePoints;
+    int SocketFd;
+    std::thread Publisher;
+    std::mutex Lock;
+    std::condition_variable Wakeup;
+    bool Stopping;
+
+} MetricsSt;
+/* Reference to metrics structure */
+typedef MetricsSt * RefMetricsSt;
+
+/*==============================================================================
+ *  MetricsParseFormat
+ *=============================================================================*/
+
+static inline CStatus MetricsParseFormat (const char * Arg, int * outFormat)
+{
+    if (strcmp (Arg, "prom") == 0) {
+        *outFormat = METRICS_FORMAT_PROM;
+    }else if (strcmp (Arg, "json") == 0) {
+        *outFormat = METRICS_FORMAT_JSON;
+    }else {
+        return C_INVALID_ARGS;
+    }
+    return C_SUCCESS;
+}
+
+/*==============================================================================
+ *  MetricsFormat
+ *=============================================================================*/
+
+static inline void MetricsFormat (RefMetricsSt Metrics, bool Final, std::string & Out)
+{
+    char Line[METRICS_LINE_LEN];
+    std::chrono::steady_clock::time_point Now = std::chrono::steady_clock::now();
+    double Elapsed = std::chrono::duration<double>(Now - Metrics->StartTime).count();
+    double Delta = std::chrono::duration<double>(Now - Metrics->LastTime).count();
+    long Points = Metrics->CompletedPoints.load (std::memory_order_relaxed);
+    long IdleNanos = Metrics->IdleNanos.load (std::memory_order_relaxed);
+    long Outstanding = Metrics->DispatchedChunks.load (std::memory_order_relaxed) -
+        Metrics->CompletedChunks.load (std::memory_order_relaxed);
+    double Rate, RecentRate, Busy, Eta;
+    long NodePoints;
+    int Node;
+
+    if (Delta <= 0) {
+        Delta = 1e-9;
+    }
+    Rate = (Elapsed > 0) ? Points / Elapsed : 0;
+    RecentRate = (Points - Metrics->LastPoints) / Delta;
+    Busy = 1 - (IdleNanos - Metrics->LastIdleNanos) * 1e-9 / Delta;
+    Busy = (Busy < 0) ? 0 : Busy;
+    Eta = (Final || Points == Metrics->TotalPoints) ? 0 :
+        (RecentRate > 0) ? (Metrics->TotalPoints - Points) / RecentRate : -1;
+
+    Out.clear();
+    if (Metrics->Config.Format == METRICS_FORMAT_PROM) {
+        snprintf (Line, sizeof(Line),
+                "# TYPE integrate_points_completed gauge\nintegrate_points_completed %ld\n"
+                "# TYPE integrate_points_total gauge\nintegrate_points_total %ld\n", Points, Metrics->TotalPoints);
+        Out += Line;
+        snprintf (Line, sizeof(Line),
+                "# TYPE integrate_points_per_second gauge\nintegrate_points_per_second %.6g\n"
+                "# TYPE integrate_points_per_second_recent gauge\nintegrate_points_per_second_recent %.6g\n",
+                Rate, RecentRate);
+        Out += Line;
+        snprintf (Line, sizeof(Line),
+                "# TYPE integrate_outstanding_chunks gauge\nintegrate_outstanding_chunks %ld\n"
+                "# TYPE integrate_master_busy_ratio gauge\nintegrate_master_busy_ratio %.4f\n", Outstanding, Busy);
+        Out += Line;
+        snprintf (Line, sizeof(Line),
+                "# TYPE integrate_eta_seconds gauge\nintegrate_eta_seconds %.6g\n"
+                "# TYPE integrate_elapsed_seconds gauge\nintegrate_elapsed_seconds %.6g\n", Eta, Elapsed);
+        Out += Line;
+        Out += "# TYPE integrate_worker_points_per_second gauge\n";
+    }else {
+        snprintf (Line, sizeof(Line), "{\"elapsed_s\":%.6g,\"completed\":%ld,\"total\":%ld,"
+                "\"points_per_s\":%.6g,\"recent_points_per_s\":%.6g,", Elapsed, Points,
+                Metrics->TotalPoints, Rate, RecentRate);
+        Out += Line;
+        snprintf (Line, sizeof(Line), "\"outstanding_chunks\":%ld,\"master_busy\":%.4f,\"eta_s\":%.6g,"
+                "\"final\":%s,\"workers\":[", Outstanding, Busy, Eta, Final ? "true" : "false");
+        Out += Line;
+    }
+
+    for (Node = 1; Node < Metrics->NoOfNodes; Node++) {
+        NodePoints = Metrics->NodePoints[Node].load (std::memory_order_relaxed);
+        if (Metrics->Config.Format == METRICS_FORMAT_PROM) {
+            snprintf (Line, sizeof(Line), "integrate_worker_points_per_second{worker=\"%d\"} %.6g\n",
+                    Node, (NodePoints - Metrics->LastNodePoints[Node]) / Delta);
+        }else {
+            snprintf (Line, sizeof(Line), "%s{\"rank\":%d,\"points\":%ld,\"points_per_s\":%.6g}",
+                    (Node > 1) ? "," : "", Node, NodePoints, (NodePoints - Metrics->LastNodePoints[Node]) / Delta);
+        }
+        Out += Line;
+        Metrics->LastNodePoints[Node] = NodePoints;
+    }
+    if (Metrics->Config.Format == METRICS_FORMAT_JSON) {
+        Out += "]}\n";
+    }
+
+    Metrics->LastTime = Now;
+    Metrics->LastPoints = Points;
+    Metrics->LastIdleNanos = IdleNanos;
+}
+
+/*==============================================================================
+ *  MetricsPublish
+ *=============================================================================*/
+
+static inline void MetricsPublish (RefMetricsSt Metrics, bool Final)
+{
+    std::string Snapshot;
+    std::string TmpPath;
+    FILE * File;
+
+    MetricsFormat (Metrics, Final, Snapshot);
+
+    if (Metrics->SocketFd >= 0) {
+        /* MSG_NOSIGNAL : a reader going away must not kill the run */
+        if (send (Metrics->SocketFd, Snapshot.c_str (), Snapshot.size (), MSG_NOSIGNAL) < 0) {
+            close (Metrics->SocketFd);
+            Metrics->SocketFd = -1;
+        }
+        return;
+    }
+    if (strncmp (Metrics->Config.Target, "unix:", 5) == 0) {
+        return;
+    }
+
+    TmpPath = std::string (Metrics->Config.Target) + ".tmp";
+    File = fopen (TmpPath.c_str (), "w");
+    if (File == NULL) {
+        return;
+    }
+    fwrite (Snapshot.c_str (), 1, Snapshot.size (), File);
+    fclose (File);
+    rename (TmpPath.c_str (), Metrics->Config.Target);
+}
+
+/*==============================================================================
+ *  MetricsStart
+ *=============================================================================*/
+
+/*
+ * called by the master only, starts the publishing thread if metrics are
+ * enabled. at most MaxOutstanding chunks are outstanding at a node.
+ */
+static inline void MetricsStart (RefMetricsSt Metrics, const MetricsConfigSt * Config,
+        int NoOfNodes, int MaxOutstanding, long TotalPoints)
+{
+    struct sockaddr_un Addr;
+    int Node;
+
+    Metrics->Config = *Config;
+    if (Config->Target == NULL) {
+        return;
+    }
+
+    Metrics->NoOfNodes = NoOfNodes;
+    Metrics->TotalPoints = TotalPoints;
+    Metrics->DispatchedChunks = 0;
+    Metrics->CompletedChunks = 0;
+    Metrics->CompletedPoints = 0;
+    Metrics->IdleNanos = 0;
+    Metrics->NodePoints = new std::atomic<long> [NoOfNodes];
+    Metrics->LastNodePoints = new long [NoOfNodes];
+    for (Node = 0; Node < NoOfNodes; Node++) {
+        Metrics->NodePoints[Node] = 0;
+        Metrics->LastNodePoints[Node] = 0;
+    }
+    Metrics->MaxOutstanding = MaxOutstanding;
+    Metrics->Outstanding = new long [NoOfNodes * MaxOutstanding];
+    Metrics->Head = new int [NoOfNodes];
+    Metrics->Count = new int [NoOfNodes];
+    memset (Metrics->Head, 0, NoOfNodes * sizeof(Metrics->Head[0]));
+    memset (Metrics->Count, 0, NoOfNodes * sizeof(Metrics->Count[0]));
+    Metrics->StartTime = Metrics->LastTime = std::chrono::steady_clock::now();
+    Metrics->LastPoints = 0;
+    Metrics->LastIdleNanos = 0;
+    Metrics->Stopping = false;
+    Metrics->SocketFd = -1;
+
+    if (strncmp (Config->Target, "unix:", 5) == 0) {
+        memset (&Addr, 0, sizeof(Addr));
+        Addr.sun_family = AF_UNIX;
+        strncpy (Addr.sun_path, Config->Target + 5, sizeof(Addr.sun_path) - 1);
+        Metrics->SocketFd = socket (AF_UNIX, SOCK_STREAM, 0);
+        if (Metrics->SocketFd >= 0 && connect (Metrics->SocketFd, (struct sockaddr *)&Addr, sizeof(Addr)) != 0) {
+            DLOG(C_WARNING, "Unable to connect to %s, metrics disabled\n", Config->Target);
+            close (Metrics->SocketFd);
+            Metrics->SocketFd = -1;
+        }
+    }
+
+    Metrics->Publisher = std::thread ([Metrics] () {
+            std::unique_lock<std::mutex> Guard (Metrics->Lock);
+            while (!Metrics->Wakeup.wait_for (Guard, std::chrono::duration<double>(Metrics->Config.Interval),
+                        [Metrics] () { return Metrics->Stopping; })) {
+                MetricsPublish (Metrics, false);
+            }
+            });
+}
+
+/*==============================================================================
+ *  MetricsStop
+ *=============================================================================*/
+
+/* publishes the final snapshot */
+static inline void MetricsStop (RefMetricsSt Metrics)
+{
+    if (Metrics->Config.Target == NULL) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> Guard (Metrics->Lock);
+        Metrics->Stopping = true;
+    }
+    Metrics->Wakeup.notify_one ();
+    Metrics->Publisher.join ();
+
+    MetricsPublish (Metrics, true);
+
+    if (Metrics->SocketFd >= 0) {
+        close (Metrics->SocketFd);
+    }
+    delete[] Metrics->NodePoints;
+    delete[] Metrics->LastNodePoints;
+    delete[] Metrics->Outstanding;
+    delete[] Metrics->Head;
+    delete[] Metrics->Count;
+}
+
+/*==============================================================================
+ *  Counters updated by the master
+ *=============================================================================*/
+
+/* Node has been sent a chunk of Points points */
+static inline void MetricsDispatched (RefMetricsSt Metrics, int Node, long Points)
+{
+    if (Metrics->Config.Target != NULL) {
+        Metrics->DispatchedChunks.fetch_add (1, std::memory_order_relaxed);
+        /* not used with work stealing, where the FIFOs of the victims would only fill up */
+        if (Metrics->Count[Node] < Metrics->MaxOutstanding) {
+            Metrics->Outstanding[Node * Metrics->MaxOutstanding +
+                (Metrics->Head[Node] + Metrics->Count[Node]) % Metrics->MaxOutstanding] = Points;
+            Metrics->Count[Node]++;
+        }
+    }
+}
+
+/* Node has computed a chunk of Points points */
+static inline void MetricsReported (RefMetricsSt Metrics, int Node, long Points)
+{
+    if (Metrics->Config.Target != NULL) {
+        Metrics->CompletedChunks.fetch_add (1, std::memory_order_relaxed);
+        Metrics->CompletedPoints.fetch_add (Points, std::memory_order_relaxed);
+        Metrics->NodePoints[Node].fetch_add (Points, std::memory_order_relaxed);
+    }
+}
+
+/* Node has reported the oldest chunk outstanding at it, its points are dropped if !Counted */
+static inline void MetricsCompleted (RefMetricsSt Metrics, int Node, bool Counted)
+{
+    long Points;
+
+    if (Metrics->Config.Target == NULL || Metrics->Count[Node] == 0) {
+        return;
+    }
+    Points = Metrics->Outstanding[Node * Metrics->MaxOutstanding + Metrics->Head[Node]];
+    Metrics->Head[Node] = (Metrics->Head[Node] + 1) % Metrics->MaxOutstanding;
+    Metrics->Count[Node]--;
+    MetricsReported (Metrics, Node, Counted ? Points : 0);
+}
+
+/* bracket the blocking receive of the master */
+static inline void MetricsIdleBegin (RefMetricsSt Metrics)
+{
+    if (Metrics->Config.Target != NULL) {
+        Metrics->IdleStart = std::chrono::steady_clock::now();
+    }
+}
+
+static inline void MetricsIdleEnd (RefMetricsSt Metrics)
+{
+    if (Metrics->Config.Target != NULL) {
+        Metrics->IdleNanos.fetch_add (std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - Metrics->IdleStart).count(), std::memory_order_relaxed);
+    }
+}
+
+#endif /* METRICS_H */
@@ -0,0 +1,192 @@
+/*
+ * File Name       :PhaseTimer.h
+ * Description     :Per phase timers for repeated trials, reduced across the nodes
+ * Author          :Karthik Rao
+ * Version         :0.1
+ *
+ * Every node splits each trial into the following phases :
+ *
+ * setup        : allocation of buffers & MPI datatypes
+ * distribution : handing out / waiting for chunks of work
+ * compute      : evaluating the integrands
+ * reduction    : sending / collecting the partial integrations
+ * shutdown     : quit handshake & cleanup
+ *
+ * Warmup trials are run but not recorded. At the end, PhaseTimerReport() gathers
+ * the times of every trial of every node & prints for every phase the min,
+ * median & max over all of them, followed by the min & max over the nodes of
+ * the per node median, which shows the imbalance between the nodes.
+ */
+#ifndef PHASETIMER_H
+#define PHASETIMER_H
+
+#include <mpi.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+
+#include "CommonHeader.h"
+
+#define PHASE_NONE          -1
+#define PHASE_SETUP          0
+#define PHASE_DISTRIBUTION   1
+#define PHASE_COMPUTE        2
+#define PHASE_REDUCTION      3
+#define PHASE_SHUTDOWN       4
+#define NO_OF_PHASES         5
+
+/* max no of recorded trials */
+#define MAX_TRIALS           100
+
+typedef struct
+{
+    /* no of trials recorded so far */
+    int NoOfTrials;
+    /* phase being timed, PHASE_NONE if none */
+    int CurPhase;
+    std::chrono::steady_clock::time_point PhaseStart;
+    /* time spent in each phase during the current trial */
+    double Elapsed[NO_OF_PHASES];
+    /* time spent in each phase of the recorded trials, the last column is the total */
+    double Trials[MAX_TRIALS][NO_OF_PHASES + 1];
+
+} PhaseTimerSt;
+/* Reference to phase timer structure */
+typedef PhaseTimerSt * RefPhaseTimerSt;
+
+static const char * PhaseNames[NO_OF_PHASES + 1] = {
+    "setup", "distribution", "compute", "reduction", "shutdown", "total"
+};
+
+/*==============================================================================
+ *  PhaseTimerBeginTrial
+ *=============================================================================*/
+
+static inline void PhaseTimerBeginTrial (RefPhaseTimerSt Timer)
+{
+    memset (Timer->Elapsed, 0, sizeof(Timer->Elapsed));
+    Timer->CurPhase = PHASE_NONE;
+}
+
+/*==============================================================================
+ *  PhaseTimerSwitch
+ *=============================================================================*/
+
+/* stop the phase being timed & start timing Phase */
+static inline void PhaseTimerSwitch (RefPhaseTimerSt Timer, int Phase)
+{
+    std::chrono::steady_clock::time_point Now = std::chrono::steady_clock::now();
+
+    if (Timer->CurPhase != PHASE_NONE) {
+        Timer->Elapsed[Timer->CurPhase] +=
+            std::chrono::duration<double>(Now - Timer->PhaseStart).count();
+    }
+    Timer->CurPhase = Phase;
+    Timer->PhaseStart = Now;
+}
+
+/*==============================================================================
+ *  PhaseTimerEndTrial
+ *=============================================================================*/
+
+static inline void PhaseTimerEndTrial (RefPhaseTimerSt Timer, bool Record)
+{
+    int Phase;
+    double Total = 0;
+
+    PhaseTimerSwitch (Timer, PHASE_NONE);
+
+    if (!Record || Timer->NoOfTrials == MAX_TRIALS) {
+        return;
+    }
+    for (Phase = 0; Phase < NO_OF_PHASES; Phase++) {
+        Timer->Trials[Timer->NoOfTrials][Phase] = Timer->Elapsed[Phase];
+        Total += Timer->Elapsed[Phase];
+    }
+    Timer->Trials[Timer->NoOfTrials][NO_OF_PHASES] = Total;
+    Timer->NoOfTrials++;
+}
+
+/*==============================================================================
+ *  PhaseTimerMedian
+ *=============================================================================*/
+
+/* sorts the values in place */
+static inline double PhaseTimerMedian (double * Values, int Count)
+{
+    if (Count == 0) {
+        return 0;
+    }
+    std::sort (Values, Values + Count);
+
+    if (Count % 2 == 1) {
+        return Values[Count / 2];
+    }
+    return (Values[Count / 2 - 1] + Values[Count / 2]) / 2;
+}
+
+/*==============================================================================
+ *  PhaseTimerPrint
+ *=============================================================================*/
+
+/*
+ * print the report from the trials of all the nodes, NoOfTrials consecutive
+ * rows of NO_OF_PHASES + 1 times per node as in PhaseTimerSt.Trials
+ */
+static inline void PhaseTimerPrint (int NoOfTrials, int CommSize, const double * AllTrials, FILE * Out)
+{
+    int Phase, Node, Trial, Count = NoOfTrials * CommSize;
+    double * Values = new double [Count];
+    double * NodeMedians = new double [CommSize];
+    double Median;
+
+    fprintf (Out, "# %d trials x %d nodes (in s)\n", NoOfTrials, CommSize);
+    fprintf (Out, "# %-12s %12s %12s %12s %12s %12s\n", "phase", "min", "median", "max",
+            "node_med_min", "node_med_max");
+
+    for (Phase = 0; Phase <= NO_OF_PHASES; Phase++) {
+        for (Node = 0; Node < CommSize; Node++) {
+            for (Trial = 0; Trial < NoOfTrials; Trial++) {
+                Values[Node * NoOfTrials + Trial] = AllTrials[(Node * NoOfTrials + Trial) * (NO_OF_PHASES + 1) + Phase];
+            }
+            NodeMedians[Node] = PhaseTimerMedian (Values + Node * NoOfTrials, NoOfTrials);
+        }
+        /* sorts the per node medians, for their min & max */
+        PhaseTimerMedian (NodeMedians, CommSize);
+        Median = PhaseTimerMedian (Values, Count);
+
+        fprintf (Out, "# %-12s %12.6g %12.6g %12.6g %12.6g %12.6g\n", PhaseNames[Phase],
+                (Count > 0) ? Values[0] : 0, Median, (Count > 0) ? Values[Count - 1] : 0,
+                NodeMedians[0], NodeMedians[CommSize - 1]);
+    }
+
+    delete[] Values;
+    delete[] NodeMedians;
+}
+
+/*==============================================================================
+ *  PhaseTimerReport
+ *=============================================================================*/
+
+/* collective over Comm, the report is printed by Root. every node has recorded the same no of trials */
+static inline void PhaseTimerReport (RefPhaseTimerSt Timer, MPI_Comm Comm, int Root, FILE * Out)
+{
+    int CommSize, ProcRank, Len = Timer->NoOfTrials * (NO_OF_PHASES + 1);
+    double * AllTrials = NULL;
+
+    MPI_Comm_size(Comm, &CommSize);
+    MPI_Comm_rank(Comm, &ProcRank);
+
+    if (ProcRank == Root) {
+        AllTrials = new double [CommSize * Len];
+    }
+    MPI_Gather (Timer->Trials, Len, MPI_DOUBLE, AllTrials, Len, MPI_DOUBLE, Root, Comm);
+
+    if (ProcRank == Root) {
+        PhaseTimerPrint (Timer->NoOfTrials, CommSize, AllTrials, Out);
+        delete[] AllTrials;
+    }
+}
+
+#endif /* PHASETIMER_H */
@@ -0,0 +1,119 @@
+/*
+ * File Name       :RefineCache.h
+ * Description     :On-disk cache of midpoint sums used by the incremental
+ *                  refinement mode
+ * Author          :Karthik Rao
+ * Version         :0.1
+ *
+ * The midpoints of a grid of M cells are a subset of the midpoints of a grid
+ * of N = r * M cells whenever r is odd : point j of the coarse grid is point
+ * (r * j + r / 2) of the fine grid. A run at N therefore only needs to
+ * evaluate the points which are not on the coarse grid, and the coarse and
+ * fine estimates give a Richardson extrapolation for free (the midpoint rule
+ * is O(h^2)).
+ *
+ * The cache is a text file with one line per completed run :
+ *
+ * <FunctionID> <Intensity> <LowerBound> <UpperBound> <NoOfPoints> <RawSum>
+ *
+ * where RawSum is the sum of f(x) over all the midpoints, not yet scaled by h.
+ */
+#ifndef REFINECACHE_H
+#define REFINECACHE_H
+
+#include <stdio.h>
+#include <math.h>
+
+#include "CommonHeader.h"
+
+/*==============================================================================
+ *  RefineCacheLookup
+ *=============================================================================*/
+
+/*
+ * find the largest cached grid for the given integrand whose midpoints are
+ * nested in a grid of NoOfPoints cells and which has at most MaxPoints cells.
+ * returns C_DATA_EOF if no such grid has been cached.
+ */
+static inline CStatus RefineCacheLookup (const char * CachePath, int FunctionID, int Intensity,
+        double LowerBound, double UpperBound, long NoOfPoints, long MaxPoints,
+        long * outCoarsePoints, double * outRawSum)
+{
+    CStatus C_Status = C_DATA_EOF;
+    FILE * CacheFile;
+    int EntryFunctionID, EntryIntensity;
+    double EntryLowerBound, EntryUpperBound, EntryRawSum;
+    long EntryPoints;
+
+    *outCoarsePoints = 0;
+
+    CacheFile = fopen (CachePath, "r");
+    if (CacheFile == NULL) {
+        return C_DATA_EOF;
+    }
+
+    while (fscanf (CacheFile, "%d %d %lf %lf %ld %lf", &EntryFunctionID, &EntryIntensity,
+                &EntryLowerBound, &EntryUpperBound, &EntryPoints, &EntryRawSum) == 6) {
+
+        if (EntryFunctionID != FunctionID || EntryIntensity != Intensity ||
+                EntryLowerBound != LowerBound || EntryUpperBound != UpperBound) {
+            continue;
+        }
+        /* the coarse midpoints are nested only for an odd refinement factor */
+        if (EntryPoints <= 0 || EntryPoints > MaxPoints || NoOfPoints % EntryPoints != 0 ||
+                (NoOfPoints / EntryPoints) % 2 == 0) {
+            continue;
+        }
+        if (EntryPoints > *outCoarsePoints) {
+            *outCoarsePoints = EntryPoints;
+            *outRawSum = EntryRawSum;
+            C_Status = C_SUCCESS;
+        }
+    }
+
+    fclose (CacheFile);
+
+    return C_Status;
+}
+
+/*==============================================================================
+ *  RefineCacheStore
+ *=============================================================================*/
+
+static inline CStatus RefineCacheStore (const char * CachePath, int FunctionID, int Intensity,
+        double LowerBound, double UpperBound, long NoOfPoints, double RawSum)
+{
+    FILE * CacheFile;
+
+    CacheFile = fopen (CachePath, "a");
+    if (CacheFile == NULL) {
+        return C_FAILURE;
+    }
+
+    fprintf (CacheFile, "%d %d %.17g %.17g %ld %.17g\n", FunctionID, Intensity,
+            LowerBound, UpperBound, NoOfPoints, RawSum);
+    fclose (CacheFile);
+
+    return C_SUCCESS;
+}
+
+/*==============================================================================
+ *  RefineRichardson
+ *=============================================================================*/
+
+/*
+ * combine a fine midpoint estimate with a nested coarse one, r = fine / coarse.
+ * the error estimate is the difference between the extrapolated and the
+ * fine estimate.
+ */
+static inline double RefineRichardson (double FineEstimate, double CoarseEstimate,
+        long Ratio, double * outError)
+{
+    double RatioSq = (double) Ratio * (double) Ratio;
+
+    *outError = fabs (FineEstimate - CoarseEstimate) / (RatioSq - 1);
+
+    return (RatioSq * FineEstimate - CoarseEstimate) / (RatioSq - 1);
+}
+
+#endif /* REFINECACHE_H */
@@ -0,0 +1,220 @@
+/*
+ * File Name       :SampleDump.h
+ * Description     :Parallel dump of the evaluated samples to a single binary
+ *                  file with MPI-IO
+ * Author          :Karthik Rao
+ * Version         :0.1
+ *
+ * With --dump <File>, every node writes the samples of the chunks it computes
+ * at their place in the file, in index order, so the whole grid lands in one
+ * file without going through the master. A record is x followed by f(x) of
+ * every integrand, or the f(x) alone with --dump-format f, all as doubles.
+ *
+ * The chunks are handed out dynamically, so the writes are independent &
+ * nonblocking (MPI_File_iwrite_at). The samples are streamed in slices of
+ * SAMPLE_DUMP_SLICE points from two buffers used in turn, a node computing
+ * the next slice while the previous one is being written. The memory used
+ * therefore does not grow with the chunk, a static block of N/(P-1) points
+ * included. A cancelled backup copy drops the slice being filled, the slices
+ * it has already written hold the same samples as the copy which completes.
+ *
+ * header (SAMPLE_DUMP_HEADER bytes) : char Magic[8] "SAMPLES1", int32 Version,
+ *          int32 RecordLen (doubles per record), int32 NoOfIntegrands,
+ *          int32 HasX, int64 NoOfPoints, double LowerBound, double UpperBound,
+ *          char DType[8] ("<f8" or ">f8"), zero padding
+ * data   : NoOfPoints x RecordLen doubles, starting at SAMPLE_DUMP_HEADER
+ *
+ * e.g. numpy.memmap (File, dtype = DType, mode = 'r', offset = 64,
+ *                    shape = (NoOfPoints, RecordLen))
+ */
+#ifndef SAMPLEDUMP_H
+#define SAMPLEDUMP_H
+
+#include <mpi.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "CommonHeader.h"
+
+#define SAMPLE_DUMP_MAGIC       "SAMPLES1"
+#define SAMPLE_DUMP_VERSION     1
+/* size of the header, the data is aligned on it */
+#define SAMPLE_DUMP_HEADER      64
+/* no of points written at a time */
+#define SAMPLE_DUMP_SLICE       4096
+
+typedef struct
+{
+    char Magic[8];
+    int32_t Version;
+    int32_t RecordLen;
+    int32_t NoOfIntegrands;
+    int32_t HasX;
+    int64_t NoOfPoints;
+    double LowerBound;
+    double UpperBound;
+    char DType[8];
+    char Padding[SAMPLE_DUMP_HEADER - 56];
+
+} SampleHeaderSt;
+
+typedef struct
+{
+    /* MPI_FILE_NULL if no dump is being written */
+    MPI_File File;
+    bool WithX;
+    int RecordLen;
+    /* two buffers of a slice used in turn, a buffer is reused once its write has completed */
+    double * Buffer[2];
+    MPI_Request WriteReq[2];
+    int Current;
+    /* first point & no of points of the slice being filled */
+    long SliceStart;
+    long SlicePoints;
+
+} SampleDumpSt;
+/* Reference to sample dump structure */
+typedef SampleDumpSt * RefSampleDumpSt;
+
+/*==============================================================================
+ *  SampleDumpParseFormat
+ *=============================================================================*/
+
+static inline CStatus SampleDumpParseFormat (const char * Arg, bool * outWithX)
+{
+    if (strcmp (Arg, "xf") == 0) {
+        *outWithX = true;
+    }else if (strcmp (Arg, "f") == 0) {
+        *outWithX = false;
+    }else {
+        return C_INVALID_ARGS;
+    }
+    return C_SUCCESS;
+}
+
+/*==============================================================================
+ *  SampleDumpOpen
+ *=============================================================================*/
+
+/*
+ * collective over Comm : create the file at its final size, the node Root
+ * writes the header. on failure the file is closed on all the nodes.
+ */
+static inline CStatus SampleDumpOpen (RefSampleDumpSt Dump, MPI_Comm Comm, int Root, const char * DumpPath,
+        long NoOfPoints, int NoOfIntegrands, double LowerBound, double UpperBound)
+{
+    SampleHeaderSt Header;
+    uint16_t ByteOrder = 1;
+    int ProcRank, Status, Failed;
+
+    MPI_Comm_rank (Comm, &ProcRank);
+    Dump->RecordLen = NoOfIntegrands + (Dump->WithX ? 1 : 0);
+    Dump->WriteReq[0] = Dump->WriteReq[1] = MPI_REQUEST_NULL;
+    Dump->Current = 0;
+    Dump->SliceStart = 0;
+    Dump->SlicePoints = 0;
+
+    if (MPI_File_open (Comm, DumpPath, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL,
+                &Dump->File) != MPI_SUCCESS) {
+        Dump->File = MPI_FILE_NULL;
+        return C_FAILURE;
+    }
+    Status = MPI_File_set_size (Dump->File, SAMPLE_DUMP_HEADER +
+            (MPI_Offset) NoOfPoints * Dump->RecordLen * sizeof(double));
+
+    if (ProcRank == Root && Status == MPI_SUCCESS) {
+        memset (&Header, 0, sizeof(Header));
+        memcpy (Header.Magic, SAMPLE_DUMP_MAGIC, sizeof(Header.Magic));
+        Header.Version = SAMPLE_DUMP_VERSION;
+        Header.RecordLen = Dump->RecordLen;
+        Header.NoOfIntegrands = NoOfIntegrands;
+        Header.HasX = Dump->WithX ? 1 : 0;
+        Header.NoOfPoints = NoOfPoints;
+        Header.LowerBound = LowerBound;
+        Header.UpperBound = UpperBound;
+        /* numpy type string of the data, in the byte order of this machine */
+        strcpy (Header.DType, (*(uint8_t *) &ByteOrder == 1) ? "<f8" : ">f8");
+        Status = MPI_File_write_at (Dump->File, 0, &Header, sizeof(Header), MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+
+    Failed = (Status != MPI_SUCCESS);
+    MPI_Allreduce (MPI_IN_PLACE, &Failed, 1, MPI_INT, MPI_MAX, Comm);
+    if (Failed) {
+        MPI_File_close (&Dump->File);
+        return C_FAILURE;
+    }
+    Dump->Buffer[0] = new double [SAMPLE_DUMP_SLICE * Dump->RecordLen];
+    Dump->Buffer[1] = new double [SAMPLE_DUMP_SLICE * Dump->RecordLen];
+    return C_SUCCESS;
+}
+
+/*==============================================================================
+ *  SampleDumpBegin
+ *=============================================================================*/
+
+/*
+ * buffer for the samples of the points from StartIndex on, NULL if no dump is
+ * being written. the slice being filled, if any, is dropped.
+ */
+static inline double * SampleDumpBegin (RefSampleDumpSt Dump, long StartIndex)
+{
+    int Next;
+
+    if (Dump->File == MPI_FILE_NULL) {
+        return NULL;
+    }
+    Next = 1 - Dump->Current;
+    MPI_Wait (&Dump->WriteReq[Next], MPI_STATUS_IGNORE);
+    Dump->Current = Next;
+    Dump->SliceStart = StartIndex;
+    Dump->SlicePoints = 0;
+    return Dump->Buffer[Next];
+}
+
+/*==============================================================================
+ *  SampleDumpWrite
+ *=============================================================================*/
+
+/* start writing the points of the slice being filled */
+static inline void SampleDumpWrite (RefSampleDumpSt Dump)
+{
+    if (Dump->SlicePoints == 0) {
+        return;
+    }
+    MPI_File_iwrite_at (Dump->File, SAMPLE_DUMP_HEADER + (MPI_Offset) Dump->SliceStart * Dump->RecordLen * sizeof(double),
+            Dump->Buffer[Dump->Current], (int) (Dump->SlicePoints * Dump->RecordLen), MPI_DOUBLE,
+            &Dump->WriteReq[Dump->Current]);
+    Dump->SlicePoints = 0;
+}
+
+/*==============================================================================
+ *  SampleDumpNext
+ *=============================================================================*/
+
+/* the record of one more point ends at Sample, a full slice is written & the next one begins */
+static inline double * SampleDumpNext (RefSampleDumpSt Dump, double * Sample)
+{
+    if (++Dump->SlicePoints < SAMPLE_DUMP_SLICE) {
+        return Sample;
+    }
+    SampleDumpWrite (Dump);
+    return SampleDumpBegin (Dump, Dump->SliceStart + SAMPLE_DUMP_SLICE);
+}
+
+/*==============================================================================
+ *  SampleDumpClose
+ *=============================================================================*/
+
+/* collective over the communicator of SampleDumpOpen, once the writes of this node are done */
+static inline void SampleDumpClose (RefSampleDumpSt Dump)
+{
+    if (Dump->File == MPI_FILE_NULL) {
+        return;
+    }
+    MPI_Waitall (2, Dump->WriteReq, MPI_STATUSES_IGNORE);
+    MPI_File_close (&Dump->File);
+    delete[] Dump->Buffer[0];
+    delete[] Dump->Buffer[1];
+}
+
+#endif /* SAMPLEDUMP_H */
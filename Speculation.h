@@ -0,0 +1,224 @@
+/*
+ * File Name       :Speculation.h
+ * Description     :Bookkeeping of the speculative backup execution of the
+ *                  straggling chunks at the end of the loop
+ * Author          :Karthik Rao
+ * Version         :0.1
+ *
+ * Once the whole range has been handed out, a slave reporting a result would
+ * normally be sent a quit, and the run lasts as long as its slowest chunk. In
+ * the backup mode the master rather sends such a slave a copy of the oldest
+ * chunk still outstanding at another slave. The first result of a chunk is
+ * kept, the other copies are cancelled & their results ignored.
+ *
+ * The master keeps, for every slave, the chunks sent to it & not yet reported,
+ * in the order they were sent. A slave computes its chunks in that order, so a
+ * result always belongs to the oldest chunk outstanding at its sender.
+ */
+#ifndef SPECULATION_H
+#define SPECULATION_H
+
+#include <string.h>
+
+#include "CommonHeader.h"
+
+/* max no of copies of a chunk being computed at the same time */
+#define SPEC_MAX_COPIES     2
+
+/* return values of SpecCompleted() */
+#define SPEC_FIRST          0
+#define SPEC_DUPLICATE      1
+#define SPEC_NONE           2
+
+typedef struct
+{
+    long StartIndex;
+    /* a copy of the chunk has already been reported */
+    bool Done;
+
+} SpecEntrySt;
+
+typedef struct
+{
+    int NoOfNodes;
+    /* max no of chunks outstanding at a slave */
+    int MaxOutstanding;
+    /* per node FIFO of the outstanding chunks, NoOfNodes x MaxOutstanding */
+    SpecEntrySt * Outstanding;
+    int * Head;
+    int * Count;
+    /* no of chunks reissued & of copies cancelled */
+    long NoOfBackups, NoOfCancels;
+
+} SpecSt;
+/* Reference to speculation structure */
+typedef SpecSt * RefSpecSt;
+
+/*==============================================================================
+ *  SpecInit
+ *=============================================================================*/
+
+static inline void SpecInit (RefSpecSt Spec, int NoOfNodes, int MaxOutstanding)
+{
+    Spec->NoOfNodes = NoOfNodes;
+    Spec->MaxOutstanding = MaxOutstanding;
+    Spec->Outstanding = new SpecEntrySt [NoOfNodes * MaxOutstanding];
+    Spec->Head = new int [NoOfNodes];
+    Spec->Count = new int [NoOfNodes];
+    memset (Spec->Head, 0, NoOfNodes * sizeof(Spec->Head[0]));
+    memset (Spec->Count, 0, NoOfNodes * sizeof(Spec->Count[0]));
+    Spec->NoOfBackups = 0;
+    Spec->NoOfCancels = 0;
+}
+
+/*==============================================================================
+ *  SpecFree
+ *=============================================================================*/
+
+static inline void SpecFree (RefSpecSt Spec)
+{
+    delete[] Spec->Outstanding;
+    delete[] Spec->Head;
+    delete[] Spec->Count;
+}
+
+/*==============================================================================
+ *  SpecEntry
+ *=============================================================================*/
+
+/* Pos-th oldest chunk outstanding at Node */
+static inline SpecEntrySt * SpecEntry (RefSpecSt Spec, int Node, int Pos)
+{
+    return &Spec->Outstanding[Node * Spec->MaxOutstanding +
+        (Spec->Head[Node] + Pos) % Spec->MaxOutstanding];
+}
+
+/*==============================================================================
+ *  SpecDispatched
+ *=============================================================================*/
+
+static inline void SpecDispatched (RefSpecSt Spec, int Node, long StartIndex)
+{
+    SpecEntrySt * Entry = SpecEntry (Spec, Node, Spec->Count[Node]);
+
+    Entry->StartIndex = StartIndex;
+    Entry->Done = false;
+    Spec->Count[Node]++;
+}
+
+/*==============================================================================
+ *  SpecHolds
+ *=============================================================================*/
+
+/* true if a copy of the chunk, not yet reported elsewhere, is outstanding at Node */
+static inline bool SpecHolds (RefSpecSt Spec, int Node, long StartIndex)
+{
+    int Pos;
+
+    for (Pos = 0; Pos < Spec->Count[Node]; Pos++) {
+        if (SpecEntry (Spec, Node, Pos)->StartIndex == StartIndex &&
+                !SpecEntry (Spec, Node, Pos)->Done) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*==============================================================================
+ *  SpecHasCopy
+ *=============================================================================*/
+
+/* true if any copy of the chunk is outstanding at Node, used to cancel the copies */
+static inline bool SpecHasCopy (RefSpecSt Spec, int Node, long StartIndex)
+{
+    int Pos;
+
+    for (Pos = 0; Pos < Spec->Count[Node]; Pos++) {
+        if (SpecEntry (Spec, Node, Pos)->StartIndex == StartIndex) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*==============================================================================
+ *  SpecCompleted
+ *=============================================================================*/
+
+/*
+ * record the result reported by Node. returns SPEC_FIRST if it is the first
+ * copy of its chunk, the copies outstanding at the other nodes are then marked
+ * done & should be cancelled. returns SPEC_DUPLICATE if another copy won, or
+ * SPEC_NONE if nothing was outstanding at Node (e.g. an initial work request).
+ */
+static inline int SpecCompleted (RefSpecSt Spec, int Node, long * outStartIndex)
+{
+    SpecEntrySt Entry;
+    int Other, Pos;
+
+    if (Spec->Count[Node] == 0) {
+        return SPEC_NONE;
+    }
+    Entry = *SpecEntry (Spec, Node, 0);
+    Spec->Head[Node] = (Spec->Head[Node] + 1) % Spec->MaxOutstanding;
+    Spec->Count[Node]--;
+
+    *outStartIndex = Entry.StartIndex;
+    if (Entry.Done) {
+        return SPEC_DUPLICATE;
+    }
+
+    for (Other = 0; Other < Spec->NoOfNodes; Other++) {
+        for (Pos = 0; Pos < Spec->Count[Other]; Pos++) {
+            if (SpecEntry (Spec, Other, Pos)->StartIndex == Entry.StartIndex) {
+                SpecEntry (Spec, Other, Pos)->Done = true;
+            }
+        }
+    }
+    return SPEC_FIRST;
+}
+
+/*==============================================================================
+ *  SpecPickBackup
+ *=============================================================================*/
+
+/*
+ * pick the chunk to be reissued to Node : the oldest one (chunks are handed out
+ * in ascending order) outstanding elsewhere, not reported yet, with less than
+ * SPEC_MAX_COPIES copies & no copy at Node. returns false if there is none.
+ */
+static inline bool SpecPickBackup (RefSpecSt Spec, int Node, long * outStartIndex)
+{
+    SpecEntrySt * Entry;
+    int Other, Pos, Copies, Holder;
+    bool Found = false;
+
+    if (Spec->Count[Node] == Spec->MaxOutstanding) {
+        return false;
+    }
+
+    for (Other = 0; Other < Spec->NoOfNodes; Other++) {
+        for (Pos = 0; Pos < Spec->Count[Other]; Pos++) {
+            Entry = SpecEntry (Spec, Other, Pos);
+            if (Other == Node || Entry->Done || (Found && Entry->StartIndex >= *outStartIndex) ||
+                    SpecHolds (Spec, Node, Entry->StartIndex)) {
+                continue;
+            }
+            Copies = 0;
+            for (Holder = 0; Holder < Spec->NoOfNodes; Holder++) {
+                Copies += SpecHolds (Spec, Holder, Entry->StartIndex) ? 1 : 0;
+            }
+            if (Copies < SPEC_MAX_COPIES) {
+                *outStartIndex = Entry->StartIndex;
+                Found = true;
+            }
+        }
+    }
+
+    if (Found) {
+        Spec->NoOfBackups++;
+    }
+    return Found;
+}
+
+#endif /* SPECULATION_H */
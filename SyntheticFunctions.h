@@ -0,0 +1,185 @@
+/*
+ * File Name       :SyntheticFunctions.h
+ * Description     :In-tree synthetic integrands with controllable cost profiles
+ * Author          :Karthik Rao
+ * Version         :0.1
+ *
+ * f1..f4 come from libfunctions.a and cost the same everywhere in [a, b], which
+ * never exercises the load balancing of the dynamic schedulers. The synthetic
+ * integrands all integrate f(x) = x, i.e. (b^2 - a^2) / 2, but the work spent
+ * per point follows a cost profile over t = (x - a) / (b - a) :
+ *
+ * FunctionID 5 : uniform  - Intensity units of work everywhere
+ * FunctionID 6 : linear   - 1x at a, rising linearly to SYNTH_LINEAR_MAX x at b
+ * FunctionID 7 : spikes   - SYNTH_SPIKE_RATE of the points, picked by a hash of x,
+ *                           cost SYNTH_SPIKE_COST x
+ * FunctionID 8 : bimodal  - two expensive bumps, centred at t = 0.25 & t = 0.75
+ *
+ * The cost profile depends only on x, so it is the same for every scheduler.
+ * On top of that, --slow-rank <Rank>:<Factor> makes one node Factor (>= 1)
+ * times slower to emulate a noisy neighbour, e.g. --slow-rank 2:4 --slow-rank 5:1.5.
+ * It applies to every integrand, f1..f4 included : the schedulers time every
+ * chunk they compute & SynthStretch keeps the core busy for the extra time.
+ */
+#ifndef SYNTHETICFUNCTIONS_H
+#define SYNTHETICFUNCTIONS_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+
+#include "CommonHeader.h"
+
+#define SYNTH_UNIFORM          5
+#define SYNTH_LINEAR           6
+#define SYNTH_SPIKES           7
+#define SYNTH_BIMODAL          8
+
+/* cost at the upper bound relative to the lower bound for the linear profile */
+#define SYNTH_LINEAR_MAX       10
+/* fraction of the points which are spikes */
+#define SYNTH_SPIKE_RATE       0.01
+/* cost of a spike relative to a normal point */
+#define SYNTH_SPIKE_COST       100
+/* peak cost of a bump relative to a normal point for the bimodal profile */
+#define SYNTH_BIMODAL_PEAK     20
+/* width of the bumps of the bimodal profile, in units of t */
+#define SYNTH_BIMODAL_WIDTH    0.05
+
+typedef struct
+{
+    double LowerBound, UpperBound;
+    /* time multiplier of this node, 1 unless the node has been slowed down */
+    double Slowdown;
+
+} SynthConfigSt;
+
+static SynthConfigSt SynthConfig = {0, 1, 1};
+
+/*==============================================================================
+ *  SynthConfigure
+ *=============================================================================*/
+
+static inline void SynthConfigure (double LowerBound, double UpperBound, double Slowdown)
+{
+    SynthConfig.LowerBound = LowerBound;
+    SynthConfig.UpperBound = (UpperBound != LowerBound) ? UpperBound : LowerBound + 1;
+    SynthConfig.Slowdown = Slowdown;
+}
+
+/*==============================================================================
+ *  SynthParseSlowdown
+ *=============================================================================*/
+
+/* parse "<Rank>:<Factor>", the factor is applied only if Rank is this node */
+static inline CStatus SynthParseSlowdown (const char * Arg, int ProcRank, double * outSlowdown)
+{
+    char * End;
+    long Rank;
+    double Factor;
+
+    Rank = strtol (Arg, &End, 10);
+    if (End == Arg || *End != ':') {
+        return C_INVALID_ARGS;
+    }
+    Factor = strtod (End + 1, &End);
+    if (*End != '\0' || Factor < 1) {
+        return C_INVALID_ARGS;
+    }
+
+    if (Rank == ProcRank) {
+        *outSlowdown = Factor;
+    }
+
+    return C_SUCCESS;
+}
+
+/*==============================================================================
+ *  SynthWork
+ *=============================================================================*/
+
+/* burn Units units of work, the result stays x */
+static inline float SynthWork (float x, double Units)
+{
+    float Result = x;
+    long i, NoOfIterations = (long) (Units + 0.5);
+
+    if (NoOfIterations < 1) {
+        NoOfIterations = 1;
+    }
+    for (i = 0; i < NoOfIterations; i++) {
+        Result = Result * 0.5f + x * 0.5f;
+    }
+    return Result;
+}
+
+/*==============================================================================
+ *  SynthStretch
+ *=============================================================================*/
+
+/* called once the work started at Start is done, spins until it has taken Slowdown times as long */
+static inline void SynthStretch (std::chrono::steady_clock::time_point Start)
+{
+    std::chrono::steady_clock::time_point Now = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point Deadline;
+
+    if (SynthConfig.Slowdown <= 1) {
+        return;
+    }
+    Deadline = Now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            (Now - Start) * (SynthConfig.Slowdown - 1));
+    while (std::chrono::steady_clock::now() < Deadline) {
+    }
+}
+
+/*==============================================================================
+ *  SynthPosition
+ *=============================================================================*/
+
+static inline double SynthPosition (float x)
+{
+    return (x - SynthConfig.LowerBound) / (SynthConfig.UpperBound - SynthConfig.LowerBound);
+}
+
+/*==============================================================================
+ *  Synthetic integrands
+ *=============================================================================*/
+
+static float SynthUniform (float x, int intensity)
+{
+    return SynthWork (x, intensity);
+}
+
+static float SynthLinear (float x, int intensity)
+{
+    return SynthWork (x, intensity * (1 + (SYNTH_LINEAR_MAX - 1) * SynthPosition (x)));
+}
+
+static float SynthSpikes (float x, int intensity)
+{
+    unsigned int Hash;
+    float Key = x;
+
+    /* a cheap integer hash of the bits of x, so that the spikes do not depend on the scheduler */
+    memcpy (&Hash, &Key, sizeof(Hash));
+    Hash ^= Hash >> 16;
+    Hash *= 0x45d9f3bU;
+    Hash ^= Hash >> 16;
+
+    if ((Hash % 10000) < (unsigned int) (SYNTH_SPIKE_RATE * 10000)) {
+        return SynthWork (x, (double) intensity * SYNTH_SPIKE_COST);
+    }
+    return SynthWork (x, intensity);
+}
+
+static float SynthBimodal (float x, int intensity)
+{
+    double t = SynthPosition (x);
+    double Bump1 = (t - 0.25) / SYNTH_BIMODAL_WIDTH;
+    double Bump2 = (t - 0.75) / SYNTH_BIMODAL_WIDTH;
+
+    return SynthWork (x, intensity * (1 + SYNTH_BIMODAL_PEAK * (exp (-Bump1 * Bump1) + exp (-Bump2 * Bump2))));
+}
+
+#endif /* SYNTHETICFUNCTIONS_H */
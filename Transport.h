@@ -0,0 +1,562 @@
+/*
+ * File Name       :Transport.h
+ * Description     :Message transport of the master-worker protocol, over MPI
+ *                  or between threads of a single process
+ * Author          :Karthik Rao
+ * Version         :0.1
+ *
+ * MasterWork & SlaveWork exchange their messages through a TransportSt, which
+ * has two backends :
+ *
+ * TRANSPORT_MPI     : every call maps onto the MPI call of the same name, on
+ *                     the communicator of the job
+ * TRANSPORT_THREADS : the nodes are threads of one process (--threads). every
+ *                     node owns a bounded lock-free queue (D. Vyukov's
+ *                     bounded MPMC queue) which all the other nodes push their
+ *                     messages onto, the message being copied into the queue.
+ *                     a send therefore completes at once. a receive pops the
+ *                     queue of its node, the messages which do not match the
+ *                     requested source & tag are set aside, in order, for the
+ *                     next receives, as MPI does. a node waiting for a message
+ *                     polls its queue & yields the core in between
+ *
+ * The collective calls of the threads (barrier, broadcast, gather, reduce)
+ * are rare & go through a scratch area shared by the nodes, guarded by a
+ * barrier built on a mutex & a condition variable.
+ *
+ * Only the messages of the master-worker protocol go through the transport,
+ * the modes which need MPI of their own (work stealing, elastic workers,
+ * MPI-IO dump) are not available with the threads, nor is --slow-rank, the
+ * slowdown being configured once per process. --affinity pins the threads.
+ */
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <mpi.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <algorithm>
+
+#include "CommonHeader.h"
+
+#define TRANSPORT_MPI           0
+#define TRANSPORT_THREADS       1
+
+/* any source or any tag of a receive */
+#define TRANSPORT_ANY           -1
+
+/* element types of a message */
+#define TRANSPORT_DOUBLE        0
+#define TRANSPORT_LONG          1
+
+/* reduction operators */
+#define TRANSPORT_SUM           0
+#define TRANSPORT_MIN           1
+#define TRANSPORT_MAX           2
+
+/* messages queued per node, a power of 2. a sender waits while the queue is full */
+#define TRANSPORT_QUEUE_LEN     256
+/* max size of a message of the threads, in bytes */
+#define TRANSPORT_MAX_BYTES     128
+/* size of the share of a node in the scratch area of the collective calls, in bytes */
+#define TRANSPORT_SCRATCH_BYTES 1024
+/* polls of an empty queue before the thread yields the core */
+#define TRANSPORT_SPIN          64
+/* padding between the counters of a queue, in bytes */
+#define TRANSPORT_CACHE_LINE    64
+
+typedef struct
+{
+    int Source;
+    int Tag;
+    int Bytes;
+    unsigned char Payload[TRANSPORT_MAX_BYTES];
+
+} TransportMsgSt;
+
+typedef struct
+{
+    /* position of the cell in the queue, tells whether it is free or full */
+    std::atomic<size_t> Sequence;
+    TransportMsgSt Msg;
+
+} TransportCellSt;
+
+typedef struct
+{
+    TransportCellSt Cells[TRANSPORT_QUEUE_LEN];
+    /* next cell to be filled & next cell to be read, padded onto their own cache lines */
+    char CellsPad[TRANSPORT_CACHE_LINE];
+    std::atomic<size_t> Tail;
+    char TailPad[TRANSPORT_CACHE_LINE];
+    std::atomic<size_t> Head;
+    char HeadPad[TRANSPORT_CACHE_LINE];
+
+} TransportQueueSt;
+
+/* state shared by the nodes of the threads backend */
+typedef struct
+{
+    int Size;
+    TransportQueueSt * Queues;
+    std::mutex Lock;
+    std::condition_variable Arrival;
+    int Arrived;
+    long Generation;
+    unsigned char * Scratch;
+
+} TransportSharedSt;
+/* Reference to shared transport structure */
+typedef TransportSharedSt * RefTransportSharedSt;
+
+typedef struct
+{
+    int Kind;
+    int Rank;
+    int Size;
+    /* communicator of the MPI backend */
+    MPI_Comm Comm;
+    /* queues of the threads backend & the messages received ahead of their turn */
+    RefTransportSharedSt Shared;
+    std::deque<TransportMsgSt> * Pending;
+
+} TransportSt;
+/* Reference to transport structure */
+typedef TransportSt * RefTransportSt;
+
+/* a send of the threads has completed as soon as it returns */
+typedef MPI_Request TransportRequest;
+
+/*==============================================================================
+ *  TransportInitMpi
+ *=============================================================================*/
+
+static inline void TransportInitMpi (RefTransportSt Transport, MPI_Comm Comm)
+{
+    Transport->Kind = TRANSPORT_MPI;
+    Transport->Comm = Comm;
+    Transport->Shared = NULL;
+    Transport->Pending = NULL;
+    MPI_Comm_size (Comm, &Transport->Size);
+    MPI_Comm_rank (Comm, &Transport->Rank);
+}
+
+/*==============================================================================
+ *  TransportSharedCreate
+ *=============================================================================*/
+
+static inline RefTransportSharedSt TransportSharedCreate (int Size)
+{
+    RefTransportSharedSt Shared = new TransportSharedSt;
+    int Node;
+    size_t Cell;
+
+    Shared->Size = Size;
+    Shared->Queues = new TransportQueueSt [Size];
+    for (Node = 0; Node < Size; Node++) {
+        for (Cell = 0; Cell < TRANSPORT_QUEUE_LEN; Cell++) {
+            Shared->Queues[Node].Cells[Cell].Sequence.store (Cell, std::memory_order_relaxed);
+        }
+        Shared->Queues[Node].Tail.store (0, std::memory_order_relaxed);
+        Shared->Queues[Node].Head.store (0, std::memory_order_relaxed);
+    }
+    Shared->Arrived = 0;
+    Shared->Generation = 0;
+    Shared->Scratch = new unsigned char [Size * TRANSPORT_SCRATCH_BYTES];
+
+    return Shared;
+}
+
+/*==============================================================================
+ *  TransportSharedFree
+ *=============================================================================*/
+
+/* once all the nodes have freed their transport */
+static inline void TransportSharedFree (RefTransportSharedSt Shared)
+{
+    delete[] Shared->Queues;
+    delete[] Shared->Scratch;
+    delete Shared;
+}
+
+/*==============================================================================
+ *  TransportInitThread
+ *=============================================================================*/
+
+static inline void TransportInitThread (RefTransportSt Transport, RefTransportSharedSt Shared, int Rank)
+{
+    Transport->Kind = TRANSPORT_THREADS;
+    Transport->Comm = MPI_COMM_NULL;
+    Transport->Shared = Shared;
+    Transport->Pending = new std::deque<TransportMsgSt>;
+    Transport->Size = Shared->Size;
+    Transport->Rank = Rank;
+}
+
+/*==============================================================================
+ *  TransportFree
+ *=============================================================================*/
+
+static inline void TransportFree (RefTransportSt Transport)
+{
+    delete Transport->Pending;
+    Transport->Pending = NULL;
+}
+
+/*==============================================================================
+ *  TransportTypeSize
+ *=============================================================================*/
+
+static inline int TransportTypeSize (int Type)
+{
+    return (Type == TRANSPORT_DOUBLE) ? sizeof(double) : sizeof(long);
+}
+
+/*==============================================================================
+ *  TransportMpiType
+ *=============================================================================*/
+
+static inline MPI_Datatype TransportMpiType (int Type)
+{
+    return (Type == TRANSPORT_DOUBLE) ? MPI_DOUBLE : MPI_LONG;
+}
+
+/*==============================================================================
+ *  TransportPush
+ *=============================================================================*/
+
+/* copy a message into the queue of Dest, false if the queue is full */
+static inline bool TransportPush (TransportQueueSt * Queue, const TransportMsgSt * Msg)
+{
+    TransportCellSt * Cell;
+    size_t Pos = Queue->Tail.load (std::memory_order_relaxed);
+    intptr_t Diff;
+
+    while (1) {
+        Cell = &Queue->Cells[Pos & (TRANSPORT_QUEUE_LEN - 1)];
+        Diff = (intptr_t) Cell->Sequence.load (std::memory_order_acquire) - (intptr_t) Pos;
+        if (Diff == 0) {
+            if (Queue->Tail.compare_exchange_weak (Pos, Pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        }else if (Diff < 0) {
+            return false;
+        }else {
+            Pos = Queue->Tail.load (std::memory_order_relaxed);
+        }
+    }
+    memcpy (&Cell->Msg, Msg, offsetof (TransportMsgSt, Payload) + Msg->Bytes);
+    Cell->Sequence.store (Pos + 1, std::memory_order_release);
+    return true;
+}
+
+/*==============================================================================
+ *  TransportPop
+ *=============================================================================*/
+
+/* take the oldest message of a queue, false if it is empty */
+static inline bool TransportPop (TransportQueueSt * Queue, TransportMsgSt * outMsg)
+{
+    TransportCellSt * Cell;
+    size_t Pos = Queue->Head.load (std::memory_order_relaxed);
+    intptr_t Diff;
+
+    while (1) {
+        Cell = &Queue->Cells[Pos & (TRANSPORT_QUEUE_LEN - 1)];
+        Diff = (intptr_t) Cell->Sequence.load (std::memory_order_acquire) - (intptr_t) (Pos + 1);
+        if (Diff == 0) {
+            if (Queue->Head.compare_exchange_weak (Pos, Pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        }else if (Diff < 0) {
+            return false;
+        }else {
+            Pos = Queue->Head.load (std::memory_order_relaxed);
+        }
+    }
+    memcpy (outMsg, &Cell->Msg, offsetof (TransportMsgSt, Payload) + Cell->Msg.Bytes);
+    Cell->Sequence.store (Pos + TRANSPORT_QUEUE_LEN, std::memory_order_release);
+    return true;
+}
+
+/*==============================================================================
+ *  TransportMatch
+ *=============================================================================*/
+
+/*
+ * look for the oldest message from Source with Tag, first among the messages
+ * set aside, then in the queue. returns its position in the pending messages,
+ * -1 if there is none yet & Wait is false
+ */
+static inline long TransportMatch (RefTransportSt Transport, int Source, int Tag, bool Wait)
+{
+    std::deque<TransportMsgSt> & Pending = *Transport->Pending;
+    TransportQueueSt * Queue = &Transport->Shared->Queues[Transport->Rank];
+    TransportMsgSt Msg;
+    size_t i;
+    int Spin = 0;
+
+    for (i = 0; i < Pending.size(); i++) {
+        if ((Source == TRANSPORT_ANY || Pending[i].Source == Source) &&
+                (Tag == TRANSPORT_ANY || Pending[i].Tag == Tag)) {
+            return (long) i;
+        }
+    }
+    while (1) {
+        if (TransportPop (Queue, &Msg)) {
+            Pending.push_back (Msg);
+            if ((Source == TRANSPORT_ANY || Msg.Source == Source) && (Tag == TRANSPORT_ANY || Msg.Tag == Tag)) {
+                return (long) Pending.size() - 1;
+            }
+            continue;
+        }
+        if (!Wait) {
+            return -1;
+        }
+        if (++Spin >= TRANSPORT_SPIN) {
+            std::this_thread::yield ();
+            Spin = 0;
+        }
+    }
+}
+
+/*==============================================================================
+ *  TransportIsend
+ *=============================================================================*/
+
+/* Buf can be reused once TransportWait has returned */
+static inline void TransportIsend (RefTransportSt Transport, int Dest, int Tag, const void * Buf, int Count,
+        int Type, TransportRequest * outReq)
+{
+    TransportMsgSt Msg;
+    int Spin = 0;
+
+    if (Transport->Kind == TRANSPORT_MPI) {
+        MPI_Isend ((void *) Buf, Count, TransportMpiType (Type), Dest, Tag, Transport->Comm, outReq);
+        return;
+    }
+    *outReq = MPI_REQUEST_NULL;
+    Msg.Source = Transport->Rank;
+    Msg.Tag = Tag;
+    Msg.Bytes = Count * TransportTypeSize (Type);
+    if (Msg.Bytes > TRANSPORT_MAX_BYTES) {
+        DLOG(C_ERROR, "Message of %d bytes, at most %d\n", Msg.Bytes, TRANSPORT_MAX_BYTES);
+        Msg.Bytes = TRANSPORT_MAX_BYTES;
+    }
+    memcpy (Msg.Payload, Buf, Msg.Bytes);
+    while (!TransportPush (&Transport->Shared->Queues[Dest], &Msg)) {
+        if (++Spin >= TRANSPORT_SPIN) {
+            std::this_thread::yield ();
+            Spin = 0;
+        }
+    }
+}
+
+/*==============================================================================
+ *  TransportWait
+ *=============================================================================*/
+
+static inline void TransportWait (RefTransportSt Transport, TransportRequest * Req)
+{
+    if (Transport->Kind == TRANSPORT_MPI) {
+        MPI_Wait (Req, MPI_STATUS_IGNORE);
+    }
+}
+
+/*==============================================================================
+ *  TransportSend
+ *=============================================================================*/
+
+static inline void TransportSend (RefTransportSt Transport, int Dest, int Tag, const void * Buf, int Count, int Type)
+{
+    TransportRequest Req;
+
+    TransportIsend (Transport, Dest, Tag, Buf, Count, Type, &Req);
+    TransportWait (Transport, &Req);
+}
+
+/*==============================================================================
+ *  TransportRecv
+ *=============================================================================*/
+
+/* receive at most Count elements, outSource & outTag may be NULL */
+static inline void TransportRecv (RefTransportSt Transport, int Source, int Tag, void * Buf, int Count, int Type,
+        int * outSource, int * outTag)
+{
+    MPI_Status Status;
+    TransportMsgSt Msg;
+    long Pos;
+
+    if (Transport->Kind == TRANSPORT_MPI) {
+        MPI_Recv (Buf, Count, TransportMpiType (Type), (Source == TRANSPORT_ANY) ? MPI_ANY_SOURCE : Source,
+                (Tag == TRANSPORT_ANY) ? MPI_ANY_TAG : Tag, Transport->Comm, &Status);
+        Source = Status.MPI_SOURCE;
+        Tag = Status.MPI_TAG;
+    }else {
+        Pos = TransportMatch (Transport, Source, Tag, true);
+        Msg = (*Transport->Pending)[Pos];
+        Transport->Pending->erase (Transport->Pending->begin() + Pos);
+        memcpy (Buf, Msg.Payload, std::min (Msg.Bytes, Count * TransportTypeSize (Type)));
+        Source = Msg.Source;
+        Tag = Msg.Tag;
+    }
+    if (outSource != NULL) {
+        *outSource = Source;
+    }
+    if (outTag != NULL) {
+        *outTag = Tag;
+    }
+}
+
+/*==============================================================================
+ *  TransportProbe
+ *=============================================================================*/
+
+/* wait for a message from Source with Tag without receiving it, returns its tag */
+static inline int TransportProbe (RefTransportSt Transport, int Source, int Tag)
+{
+    MPI_Status Status;
+
+    if (Transport->Kind == TRANSPORT_MPI) {
+        MPI_Probe ((Source == TRANSPORT_ANY) ? MPI_ANY_SOURCE : Source, (Tag == TRANSPORT_ANY) ? MPI_ANY_TAG : Tag,
+                Transport->Comm, &Status);
+        return Status.MPI_TAG;
+    }
+    return (*Transport->Pending)[TransportMatch (Transport, Source, Tag, true)].Tag;
+}
+
+/*==============================================================================
+ *  TransportIprobe
+ *=============================================================================*/
+
+/* true if a message from Source with Tag can be received */
+static inline bool TransportIprobe (RefTransportSt Transport, int Source, int Tag)
+{
+    MPI_Status Status;
+    int Flag;
+
+    if (Transport->Kind == TRANSPORT_MPI) {
+        MPI_Iprobe ((Source == TRANSPORT_ANY) ? MPI_ANY_SOURCE : Source, (Tag == TRANSPORT_ANY) ? MPI_ANY_TAG : Tag,
+                Transport->Comm, &Flag, &Status);
+        return Flag;
+    }
+    return (TransportMatch (Transport, Source, Tag, false) >= 0);
+}
+
+/*==============================================================================
+ *  TransportBarrier
+ *=============================================================================*/
+
+static inline void TransportBarrier (RefTransportSt Transport)
+{
+    RefTransportSharedSt Shared = Transport->Shared;
+
+    if (Transport->Kind == TRANSPORT_MPI) {
+        MPI_Barrier (Transport->Comm);
+        return;
+    }
+    std::unique_lock<std::mutex> Guard (Shared->Lock);
+    long Generation = Shared->Generation;
+    if (++Shared->Arrived == Shared->Size) {
+        Shared->Arrived = 0;
+        Shared->Generation++;
+        Shared->Arrival.notify_all ();
+    }else {
+        Shared->Arrival.wait (Guard, [Shared, Generation] { return Shared->Generation != Generation; });
+    }
+}
+
+/*==============================================================================
+ *  TransportBcast
+ *=============================================================================*/
+
+/* at most Size * TRANSPORT_SCRATCH_BYTES */
+static inline void TransportBcast (RefTransportSt Transport, void * Buf, int Bytes, int Root)
+{
+    if (Transport->Kind == TRANSPORT_MPI) {
+        MPI_Bcast (Buf, Bytes, MPI_BYTE, Root, Transport->Comm);
+        return;
+    }
+    /* the scratch area is free again once every node has left the previous collective call */
+    if (Transport->Rank == Root) {
+        memcpy (Transport->Shared->Scratch, Buf, Bytes);
+    }
+    TransportBarrier (Transport);
+    if (Transport->Rank != Root) {
+        memcpy (Buf, Transport->Shared->Scratch, Bytes);
+    }
+    TransportBarrier (Transport);
+}
+
+/*==============================================================================
+ *  TransportGather
+ *=============================================================================*/
+
+/* Count doubles per node, at most TRANSPORT_SCRATCH_BYTES, RecvBuf is only used at Root */
+static inline void TransportGather (RefTransportSt Transport, const double * SendBuf, double * RecvBuf, int Count,
+        int Root)
+{
+    unsigned char * Scratch = Transport->Shared ? Transport->Shared->Scratch : NULL;
+    int Node;
+
+    if (Transport->Kind == TRANSPORT_MPI) {
+        MPI_Gather ((void *) SendBuf, Count, MPI_DOUBLE, RecvBuf, Count, MPI_DOUBLE, Root, Transport->Comm);
+        return;
+    }
+    memcpy (Scratch + Transport->Rank * TRANSPORT_SCRATCH_BYTES, SendBuf, Count * sizeof(double));
+    TransportBarrier (Transport);
+    if (Transport->Rank == Root) {
+        for (Node = 0; Node < Transport->Size; Node++) {
+            memcpy (RecvBuf + Node * Count, Scratch + Node * TRANSPORT_SCRATCH_BYTES, Count * sizeof(double));
+        }
+    }
+    TransportBarrier (Transport);
+}
+
+/*==============================================================================
+ *  TransportReduce
+ *=============================================================================*/
+
+/* Count doubles, at most TRANSPORT_SCRATCH_BYTES, at Root SendBuf may be RecvBuf for a reduction in place */
+static inline void TransportReduce (RefTransportSt Transport, const double * SendBuf, double * RecvBuf, int Count,
+        int Op, int Root)
+{
+    unsigned char * Scratch = Transport->Shared ? Transport->Shared->Scratch : NULL;
+    const double * Value;
+    int Node, i;
+
+    if (Transport->Kind == TRANSPORT_MPI) {
+        MPI_Reduce ((Transport->Rank == Root && SendBuf == RecvBuf) ? MPI_IN_PLACE : (void *) SendBuf, RecvBuf,
+                Count, MPI_DOUBLE, (Op == TRANSPORT_SUM) ? MPI_SUM : (Op == TRANSPORT_MIN) ? MPI_MIN : MPI_MAX,
+                Root, Transport->Comm);
+        return;
+    }
+    memcpy (Scratch + Transport->Rank * TRANSPORT_SCRATCH_BYTES, SendBuf, Count * sizeof(double));
+    TransportBarrier (Transport);
+    if (Transport->Rank == Root) {
+        /* in rank order, so that the sum does not depend on the timing */
+        for (Node = 0; Node < Transport->Size; Node++) {
+            Value = (const double *) (Scratch + Node * TRANSPORT_SCRATCH_BYTES);
+            for (i = 0; i < Count; i++) {
+                if (Node == 0) {
+                    RecvBuf[i] = Value[i];
+                }else if (Op == TRANSPORT_SUM) {
+                    RecvBuf[i] += Value[i];
+                }else if (Op == TRANSPORT_MIN) {
+                    RecvBuf[i] = std::min (RecvBuf[i], Value[i]);
+                }else {
+                    RecvBuf[i] = std::max (RecvBuf[i], Value[i]);
+                }
+            }
+        }
+    }
+    TransportBarrier (Transport);
+}
+
+#endif /* TRANSPORT_H */
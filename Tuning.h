@@ -0,0 +1,142 @@
+/*
+ * File Name       :Tuning.h
+ * Description     :Tuning file of the schedulers, filled in by the autotuning
+ *                  mode of advnc_sched & consulted at startup
+ * Author          :Karthik Rao
+ * Version         :0.1
+ *
+ * The tuning file is a text file with one line per scheduling policy tuned
+ * for a configuration :
+ *
+ * <FunctionID> <Intensity> <NBucket> <P> <Sched> <Granularity> <PrefetchDepth> <Time>
+ *
+ * where FunctionID & Intensity are the arguments as given (comma separated
+ * lists included), NBucket is floor(log10(NoOfPoints)), P the no of nodes,
+ * & Time the median time of the truncated tuning runs. Lines starting with
+ * '#' are comments. New lines are appended, the last line of a policy for a
+ * configuration wins.
+ */
+#ifndef TUNING_H
+#define TUNING_H
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "CommonHeader.h"
+
+/* tuning file consulted by default, "none" disables the lookup */
+#define TUNING_FILE             "sched_tuning.txt"
+/* max length of a line of the tuning file */
+#define TUNING_LINE_LEN         256
+/* max length of a policy name & of the FunctionID / Intensity lists */
+#define TUNING_NAME_LEN         16
+#define TUNING_LIST_LEN         64
+/* max no of policies of a configuration */
+#define TUNING_MAX_POLICIES     8
+
+typedef struct
+{
+    char Sched[TUNING_NAME_LEN];
+    long Granularity;
+    int PrefetchDepth;
+    double Time;
+
+} TuningEntrySt;
+
+/*==============================================================================
+ *  TuningBucket
+ *=============================================================================*/
+
+static inline int TuningBucket (long NoOfPoints)
+{
+    return (int) floor (log10 ((double) NoOfPoints));
+}
+
+/*==============================================================================
+ *  TuningLookup
+ *=============================================================================*/
+
+/*
+ * find the tuned policy of a configuration : the given one if Sched is not
+ * NULL, else the fastest one. returns C_DATA_EOF if the configuration (or the
+ * policy) has not been tuned.
+ */
+static inline CStatus TuningLookup (const char * TuningPath, const char * FunctionArg,
+        const char * IntensityArg, long NoOfPoints, int CommSize, const char * Sched,
+        TuningEntrySt * outEntry)
+{
+    TuningEntrySt Policies[TUNING_MAX_POLICIES];
+    TuningEntrySt Entry;
+    char Line[TUNING_LINE_LEN];
+    char EntryFunction[TUNING_LIST_LEN], EntryIntensity[TUNING_LIST_LEN];
+    int NoOfPolicies = 0, EntryBucket, EntryCommSize, i;
+    FILE * TuningFile;
+
+    TuningFile = fopen (TuningPath, "r");
+    if (TuningFile == NULL) {
+        return C_DATA_EOF;
+    }
+
+    while (fgets (Line, sizeof(Line), TuningFile) != NULL) {
+        if (Line[0] == '#' || sscanf (Line, "%63s %63s %d %d %15s %ld %d %lf", EntryFunction,
+                    EntryIntensity, &EntryBucket, &EntryCommSize, Entry.Sched, &Entry.Granularity,
+                    &Entry.PrefetchDepth, &Entry.Time) != 8) {
+            continue;
+        }
+        if (strcmp (EntryFunction, FunctionArg) != 0 || strcmp (EntryIntensity, IntensityArg) != 0 ||
+                EntryBucket != TuningBucket (NoOfPoints) || EntryCommSize != CommSize ||
+                (Sched != NULL && strcmp (Entry.Sched, Sched) != 0)) {
+            continue;
+        }
+        /* a later line replaces the earlier one of the same policy */
+        for (i = 0; i < NoOfPolicies; i++) {
+            if (strcmp (Policies[i].Sched, Entry.Sched) == 0) {
+                break;
+            }
+        }
+        if (i < TUNING_MAX_POLICIES) {
+            Policies[i] = Entry;
+            NoOfPolicies = (i == NoOfPolicies) ? NoOfPolicies + 1 : NoOfPolicies;
+        }
+    }
+    fclose (TuningFile);
+
+    if (NoOfPolicies == 0) {
+        return C_DATA_EOF;
+    }
+    *outEntry = Policies[0];
+    for (i = 1; i < NoOfPolicies; i++) {
+        if (Policies[i].Time < outEntry->Time) {
+            *outEntry = Policies[i];
+        }
+    }
+    return C_SUCCESS;
+}
+
+/*==============================================================================
+ *  TuningStore
+ *=============================================================================*/
+
+static inline CStatus TuningStore (const char * TuningPath, const char * FunctionArg,
+        const char * IntensityArg, long NoOfPoints, int CommSize, const TuningEntrySt * Entry)
+{
+    FILE * TuningFile;
+
+    if (strlen (FunctionArg) >= TUNING_LIST_LEN || strlen (IntensityArg) >= TUNING_LIST_LEN) {
+        return C_INVALID_ARGS;
+    }
+
+    TuningFile = fopen (TuningPath, "a");
+    if (TuningFile == NULL) {
+        return C_FAILURE;
+    }
+    fprintf (TuningFile, "%s %s %d %d %s %ld %d %.9g\n", FunctionArg, IntensityArg,
+            TuningBucket (NoOfPoints), CommSize, Entry->Sched, Entry->Granularity,
+            Entry->PrefetchDepth, Entry->Time);
+    fclose (TuningFile);
+
+    return C_SUCCESS;
+}
+
+#endif /* TUNING_H */
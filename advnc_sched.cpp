@@ -7,11 +7,31 @@
  *
  * To compile :
  *
- * mpicxx -std=c++11 advnc_sched.cpp -o advnc_sched libfunctions.a libintegrate.a  
+ * mpicxx -std=c++11 -pthread advnc_sched.cpp -o advnc_sched libfunctions.a libintegrate.a  
  * 
  * Sample command line execution :
  * 
  * mpirun -n 3 ./advnc_sched 1 0 10 1000 1
+ * mpirun -n 3 ./advnc_sched 1,2,3,4 0 10 1000 1
+ * mpirun -n 3 ./advnc_sched 1 0 10 3000 1 --refine result/refine.cache
+ * mpirun -n 3 ./advnc_sched 1 0 10 1000 1 --sched dynamic
+ * mpirun -n 9 ./advnc_sched 1 0 10 1000000 1 --sched hybrid --static-fraction 0.9
+ * mpirun -n 3 ./advnc_sched 1 0 10 1000 1 --repeat 10 --warmup 2
+ * mpirun -n 3 ./advnc_sched 6 0 10 1000 100 --slow-rank 1:4
+ * mpirun -n 3 ./advnc_sched 1 0 10 1000 1 --affinity master
+ * mpirun -n 5 ./advnc_sched 6 0 10 100000 100 --steal
+ * mpirun -n 5 ./advnc_sched 6 0 10 100000 100 --backup --slow-rank 2:8
+ * mpirun -n 5 ./advnc_sched 6 0 10 10000000 100 --metrics result/progress.prom --metrics-interval 2
+ * mpirun -n 3 ./advnc_sched 6 0 10 100000000 100 --elastic 6 --elastic-backlog 30
+ * mpirun -n 5 ./advnc_sched 1,2 0 10 1000000 1 --dump result/samples.bin --dump-format xf
+ * mpirun -n 9 ./advnc_sched 6 0 10 10000000 100 --order lpt
+ * ./advnc_sched 6 0 10 1000000 100 --threads 4
+ * mpirun -n 3 ./advnc_sched --daemon /tmp/integrate.sock
+ * echo "1 0 10 1000 1 --sched static" | nc -U /tmp/integrate.sock
+ * mpirun -n 32 ./advnc_sched --jobs result/jobs.txt --group-size 4
+ * mpirun -n 5 ./advnc_sched 6 0 10 100000 100 --record result/sched.log
+ * mpirun -n 5 ./advnc_sched 6 0 10 100000 100 --replay result/sched.log
+ * mpirun -n 9 ./advnc_sched --autotune sched_tuning.txt 6 0 10 100000000 100 --tune-points 1000000
  * qsub -d $(pwd) -q mamba -l procs=2 -v FID=1,A=0,B=10,N=1000,INTENSITY=1,PROC=2 ./run_static.sh
  *
  */
@@ -21,7 +41,9 @@
 /* Max no of processors available in the system */
 #define MAX_PROCESSORS 32
 /* max no of chunk of work available at the slave at any point of time */
-#define MAX_CHUNK 3
+#define MAX_CHUNK 8
+/* no of chunks prefetched by the advanced scheduler, unless tuned */
+#define DEFAULT_PREFETCH_DEPTH 3
 /* rank of the master node */
 #define MASTER_NODE 0
 /* message from master to the slave indicating that the work is available */
@@ -32,6 +54,36 @@
 #define SLAVE_TO_MASTER_REQ_WORK 3000
 /* message from slave to master indicating that the slave is terminating */
 #define SLAVE_TO_MASTER_EXITING 4000
+/* message from master to slave indicating that the whole range has been handed out */
+#define MASTER_TO_SLAVE_RANGE_DONE 5000
+/* message from a slave to a peer asking for one of its queued chunks */
+#define SLAVE_TO_SLAVE_STEAL_REQ 6000
+/* message from a slave to a peer carrying a stolen chunk */
+#define SLAVE_TO_SLAVE_STEAL_GRANT 7000
+/* message from a slave to a peer indicating that it has no chunk to give */
+#define SLAVE_TO_SLAVE_STEAL_DENY 8000
+/* message from master to slave indicating that a copy of a chunk is no longer needed */
+#define MASTER_TO_SLAVE_CANCEL 9000
+/* no of points between two checks for a cancel, in the backup mode */
+#define BACKUP_POLL_POINTS 16
+/* no of cancels remembered by a slave, a forgotten cancel only costs a redundant computation */
+#define BACKUP_CANCEL_LEN (2 * MAX_CHUNK)
+/* max no of chunks queued at a slave in the work stealing mode, the prefetched ones + a stolen one */
+#define STEAL_QUEUE_LEN (MAX_CHUNK + 1)
+/* max length of a request line served by the daemon */
+#define DAEMON_REQUEST_LEN 512
+/* max no of arguments in a request line served by the daemon */
+#define DAEMON_MAX_ARGS 32
+/* default fraction of the range split statically by the hybrid scheduler */
+#define HYBRID_STATIC_FRACTION 0.8
+/* max fraction of the range split statically when it is derived from the speed of the slaves */
+#define HYBRID_MAX_FRACTION 0.95
+/* no of points of the truncated runs of the autotuning mode, unless given */
+#define TUNE_POINTS 100000
+/* no of recorded trials of every tuning run, after a warmup */
+#define TUNE_TRIALS 3
+/* max no of jobs in a job list */
+#define MAX_JOBS 256
 
 #include <mpi.h>
 #include <stdio.h>
@@ -40,27 +92,27 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <signal.h>
 #include <chrono>
 #include <string.h>
 #include <cmath>
 
 #include "CommonHeader.h"
+#include "Integrand.h"
+#include "RefineCache.h"
+#include "PhaseTimer.h"
+#include "Affinity.h"
+#include "Speculation.h"
+#include "Metrics.h"
+#include "Tuning.h"
+#include "DecisionLog.h"
+#include "Elastic.h"
+#include "SampleDump.h"
+#include "CostOrder.h"
+#include "Transport.h"
 
-#ifdef __cplusplus
-extern "C" {
-#endif
-
-    float f1(float x, int intensity);
-    float f2(float x, int intensity);
-    float f3(float x, int intensity);
-    float f4(float x, int intensity);
-
-#ifdef __cplusplus
-}
-#endif
-
-/* function pointer to one of the following functions : f1, f2, f3, f4 */
-typedef float (*Func) (float, int);
 
 
 typedef struct
@@ -69,15 +121,67 @@ typedef struct
     long StartIndex;
     /* stopping value of the range of indices a thread is supposed to execute */
     long StopIndex;
-    int Intensity;
     /*   !!!!  should this be long ?   */
     long NoOfPoints;
     double LowerBound, UpperBound;
-    int Granularity;
+    long Granularity;
+    /* no of chunks queued at a slave at any point of time, at most MAX_CHUNK */
+    int PrefetchDepth;
     /* stores the max value of the index upto which the integral has been computed */
     long CompletedIndex;
-    /* function pointer to one of the following functions : f1, f2, f3, f4 */
-    Func FuncToIntegrate;
+    /* integrands computed in a single pass over the grid */
+    IntegrandSt Integrands[MAX_INTEGRANDS];
+    int NoOfIntegrands;
+    /* cache of previous runs used by the refinement mode, NULL if disabled */
+    const char * RefineCachePath;
+    /* ratio to the cached coarse grid whose points are skipped, 0 if none */
+    long ReuseStride;
+    /* sum of f(x) over the cached coarse grid, per integrand */
+    double ReuseRawSum[MAX_INTEGRANDS];
+    /* result & time taken, filled in by the master */
+    double IntegralOutput[MAX_INTEGRANDS];
+    double ElapsedTime;
+    /* Richardson extrapolation of the refinement mode, the error is -1 if unavailable */
+    double Extrapolated[MAX_INTEGRANDS];
+    double ExtrapolationError[MAX_INTEGRANDS];
+    /* the job is repeated NoOfTrials times after NoOfWarmups unrecorded runs */
+    int NoOfTrials, NoOfWarmups;
+    /* time spent in each phase by this node */
+    PhaseTimerSt Timer;
+    /* placement of the nodes on the cores, applied once at startup */
+    int AffinityLayout;
+    /* once the range is handed out, idle slaves steal the queued chunks of their peers */
+    bool WorkStealing;
+    /* once the range is handed out, idle slaves get copies of the outstanding chunks */
+    bool SpeculativeBackup;
+    /* start index of the chunks cancelled by the master, used by the slaves in the backup mode */
+    long CancelledChunks[BACKUP_CANCEL_LEN];
+    int CancelSlot;
+    /* live progress published by the master, disabled if the target is NULL */
+    MetricsConfigSt Metrics;
+    /* nodes running the job, the master is MASTER_NODE of this communicator, MPI_COMM_NULL with the threads */
+    MPI_Comm Comm;
+    /* messages of the master-worker protocol, over Comm or between the threads of this process */
+    TransportSt Transport;
+    /* fraction of the range split statically between the slaves, -1 to derive it from their speed */
+    double StaticFraction;
+    /* iterations [0, StaticPoints) are split statically, the master serves the rest */
+    long StaticPoints;
+    /* decision log written by the master & log replayed instead of the range, NULL if disabled */
+    const char * RecordPath;
+    const char * ReplayPath;
+    /* log being replayed, read by the master only */
+    DecisionLogSt Replay;
+    /* workers the master may spawn while the job runs, disabled if MaxWorkers is 0 */
+    ElasticConfigSt Elastic;
+    /* "<FunctionID> <LowerBound> <UpperBound> <NoOfPoints> <Intensity>" of the job, passed to the workers */
+    char ** JobArgv;
+    /* file the evaluated samples are written to, NULL if disabled */
+    const char * DumpPath;
+    SampleDumpSt Dump;
+    /* order the master hands out the chunks in, DISPATCH_ORDER_LPT serves them by decreasing cost */
+    int DispatchOrder;
+    CostOrderSt Order;
 
 } ThreadData;
 /*Reference to thread private structure */
@@ -98,12 +202,55 @@ typedef IndexSt * RefIndexSt;
 bool IsLoopDone (void * inArg);
 /* function to get the next loop iteration values */
 int GetNextLoop (void * inArg);
+/* function to get the no of points not handed out yet */
+static long PointsLeft (void * inArg);
 /* function which will be executed by the slave nodes */
 static void SlaveWork (void * inArg);
+/* function which will be executed by the slave nodes in the work stealing mode */
+static void SlaveStealWork (void * inArg);
 /* function which will be executed by the master node */
 static void MasterWork (void * inArg);
+/* function to send a message without payload to all the slaves */
+static void NotifySlaves (MPI_Comm Comm, int Tag);
+/* function to create the MPI datatype of IndexSt */
+static void CreateIndexType (MPI_Datatype * outType);
+/* function to integrate a chunk of iterations for all the integrands */
+static bool ComputeChunk (void * inArg, long StartIndex, long StopIndex, double * outIntegral);
+/* function to receive the pending cancels & check if a chunk has been cancelled */
+static bool PollCancel (void * inArg, long StartIndex);
+/* function to get the next chunk of a slave, from the range or from the replayed log */
+static bool NextChunk (void * inArg, int Node, RefIndexSt outIndex);
 /* function to used to index the 2D struct of indices */
 int GetFreeChunkIndex (int Node, int * ChunkIndex);
+/* function to look up the coarse grid reused by the refinement mode */
+static void RefineSetup (void * inArg);
+/* function to cache & extrapolate the result of the refinement mode */
+static void RefineFinish (void * inArg);
+/* function to parse the arguments of a single integration job, given on the command line or not */
+static CStatus ParseJob (int argc, char * argv[], MPI_Comm Comm, bool CommandLine, void * inArg);
+/* function to run a single integration job on all the nodes */
+static void RunJob (void * inArg);
+/* function which serves integration requests over a UNIX domain socket */
+static void DaemonWork (const char * SocketPath);
+/* function which runs the jobs of a job list concurrently on groups of nodes */
+static void JobListWork (const char * JobPath, int GroupSize);
+/* function to split a request line into arguments, modifies the line */
+static int SplitRequest (char * Request, char * outArgv[]);
+/* function to write the result of a job on a single line */
+static void WriteJobResult (FILE * Out, void * inArg);
+/* function to derive the static fraction of the hybrid scheduler from the speed of the slaves */
+static void HybridCalibrate (void * inArg);
+/* function which searches the fastest scheduling policy of a configuration & stores it */
+static void TuneWork (const char * TuningPath, int argc, char * argv[]);
+/* function to time a truncated run of a scheduling policy during the autotuning */
+static double TuneRun (int argc, char * argv[], const char * Sched, long Granularity, int PrefetchDepth);
+/* function which will be executed by a worker spawned by the master */
+static void ElasticWorkerWork (int argc, char * argv[]);
+/* function to send a chunk to a slave or to a spawned worker */
+static void SendChunk (RefThreadData ThreadInfo, RefElasticSt Elastic, int Node, int Tag, IndexSt * Index,
+        TransportRequest * outReq);
+/* function which runs the job with the master & the slaves as threads of this process */
+static void ThreadsWork (int argc, char * argv[]);
 /*==============================================================================
  *  main
  *=============================================================================*/
@@ -111,92 +258,1246 @@ int GetFreeChunkIndex (int Node, int * ChunkIndex);
 int main (int argc, char* argv[]) {
 
 
-    if (argc < 6) {
+    bool DaemonMode = ((argc == 3 || argc == 5) && strcmp (argv[1], "--daemon") == 0);
+    bool JobListMode = ((argc == 3 || (argc == 5 && strcmp (argv[3], "--group-size") == 0)) &&
+            strcmp (argv[1], "--jobs") == 0);
+    bool TuneMode = (argc >= 8 && strcmp (argv[1], "--autotune") == 0);
+    bool WorkerMode = (argc >= 7 && strcmp (argv[1], ELASTIC_WORKER_ARG) == 0);
+    bool ThreadsMode = false;
+    for (int Arg = 6; Arg < argc && !DaemonMode && !JobListMode && !TuneMode && !WorkerMode; Arg++) {
+        ThreadsMode = ThreadsMode || (strcmp (argv[Arg], "--threads") == 0);
+    }
+
+    if (argc < 6 && !DaemonMode && !JobListMode) {
         std::cerr<<"Usage: "<<argv[0]<<" <FunctionID> <LowerBound> <UpperBound> \
-            <NoOfPoints> <Intensity> "<<std::endl;
+            <NoOfPoints> <Intensity> [--sched static|dynamic|advnc|hybrid] [--static-fraction <F>|auto] \
+            [--granularity <Points>] [--prefetch <Chunks>] [--tuning <TuningFile>|none] [--refine <CacheFile>] \
+            [--repeat <Trials>] [--warmup <Trials>] [--slow-rank <Rank>:<Factor>] \
+            [--affinity compact|scatter|master] [--steal] [--backup] \
+            [--metrics <File>|unix:<Socket>] [--metrics-interval <Seconds>] [--metrics-format prom|json] \
+            [--record <LogFile>] [--replay <LogFile>] [--elastic <Workers>] [--elastic-backlog <Seconds>] \
+            [--dump <File>] [--dump-format xf|f] [--order index|lpt] [--threads <Slaves>]"<<std::endl;
+        std::cerr<<"       "<<argv[0]<<" --daemon <SocketPath> [--affinity compact|scatter|master]"<<std::endl;
+        std::cerr<<"       "<<argv[0]<<" --jobs <JobFile> [--group-size <Nodes>]"<<std::endl;
+        std::cerr<<"       "<<argv[0]<<" --autotune <TuningFile> <FunctionID> <LowerBound> <UpperBound> \
+            <NoOfPoints> <Intensity> [--tune-points <Points>] [options]"<<std::endl;
 
         return -1;
     }
 
+    /* the threaded backend runs without MPI */
+    if (ThreadsMode) {
+        ThreadsWork (argc - 1, argv + 1);
+        return 0;
+    }
+
     MPI_Init(NULL, NULL);
 
-    int FunctionID;
-    int CommSize;
+    int k;
     int ProcRank;
-    MPI_Comm_size(MPI_COMM_WORLD, &CommSize);
     MPI_Comm_rank(MPI_COMM_WORLD, &ProcRank);
 
     ThreadData ThreadInfo;
 
-    FunctionID  = atoi (argv[1]);
-    ThreadInfo.LowerBound  = atof (argv[2]);
-    ThreadInfo.UpperBound  = atof (argv[3]);
-    ThreadInfo.NoOfPoints  = atol (argv[4]);
-    ThreadInfo.Intensity   = atoi (argv[5]);
-    ThreadInfo.StartIndex = 0;
-    ThreadInfo.StopIndex = 0;
-    ThreadInfo.CompletedIndex = 0;
+    if (DaemonMode) {
+        int AffinityLayout = AFFINITY_NONE;
+        if (argc == 5 && (strcmp (argv[3], "--affinity") != 0 ||
+                    AffinityParse (argv[4], &AffinityLayout) != C_SUCCESS)) {
+            DLOG(C_ERROR, "Invalid option %s %s\n", argv[3], argv[4]);
+            goto EXIT;
+        }
+        if (AffinityLayout != AFFINITY_NONE) {
+            AffinityBind (AffinityLayout, MPI_COMM_WORLD, MASTER_NODE);
+            AffinityReport (MPI_COMM_WORLD, MASTER_NODE, stdout);
+        }
+        DaemonWork (argv[2]);
+        goto EXIT;
+    }
+
+    if (JobListMode) {
+        JobListWork (argv[2], (argc == 5) ? atoi (argv[4]) : 0);
+        goto EXIT;
+    }
+
+    if (TuneMode) {
+        TuneWork (argv[2], argc - 3, argv + 3);
+        goto EXIT;
+    }
+
+    if (WorkerMode) {
+        ElasticWorkerWork (argc - 2, argv + 2);
+        goto EXIT;
+    }
+
+    if (ParseJob (argc - 1, argv + 1, MPI_COMM_WORLD, true, &ThreadInfo) != C_SUCCESS) {
+        goto EXIT;
+    }
+
+    /* pin the node before any buffer is allocated, so that the buffers are first touched on its core */
+    if (ThreadInfo.AffinityLayout != AFFINITY_NONE) {
+        AffinityBind (ThreadInfo.AffinityLayout, MPI_COMM_WORLD, MASTER_NODE);
+        AffinityReport (MPI_COMM_WORLD, MASTER_NODE, stdout);
+    }
+
+    RunJob (&ThreadInfo);
+
+    /* display the sum and the time taken to compute it.
+     * the refinement mode adds the extrapolated estimate & its error when available */
+    if (ProcRank == MASTER_NODE){
+        for (k = 0; k < ThreadInfo.NoOfIntegrands; k++) {
+            if (ThreadInfo.RefineCachePath != NULL && ThreadInfo.ExtrapolationError[k] >= 0) {
+                std::cout<<ThreadInfo.IntegralOutput[k]<<" "<<ThreadInfo.Extrapolated[k]
+                    <<" "<<ThreadInfo.ExtrapolationError[k]<<std::endl;
+            }else {
+                std::cout<<ThreadInfo.IntegralOutput[k]<<std::endl;
+            }
+        }
+        std::cerr<<ThreadInfo.ElapsedTime<<std::endl;
+    }
+    /* the phase breakdown goes to stdout */
+    if (ThreadInfo.NoOfWarmups + ThreadInfo.NoOfTrials > 1) {
+        PhaseTimerReport (&ThreadInfo.Timer, MPI_COMM_WORLD, MASTER_NODE, stdout);
+    }
+
+
+EXIT:
+    MPI_Finalize();
+
+    return 0;
+
+}
+
+/*==============================================================================
+ *  ParseJob
+ *=============================================================================*/
+
+/*
+ * parse "<FunctionID> <LowerBound> <UpperBound> <NoOfPoints> <Intensity> [options]",
+ * used both for the command line and for the requests served by the daemon
+ */
+static CStatus ParseJob (int argc, char * argv[], MPI_Comm Comm, bool CommandLine, void * inArg)
+{
+    RefThreadData ThreadInfo = (RefThreadData)inArg;
+    ThreadInfo->Comm = Comm;
+    /* with the threads, the transport has been set up by the caller */
+    if (Comm != MPI_COMM_NULL) {
+        TransportInitMpi (&ThreadInfo->Transport, Comm);
+    }
+    const char * Sched = "advnc";
+    bool SchedGiven = false;
+    /* chunk size & prefetch depth given on the command line, 0 if not */
+    long Granularity = 0;
+    int PrefetchDepth = 0;
+    /* policy found in the tuning file */
+    const char * TuningPath = TUNING_FILE;
+    TuningEntrySt Tuned;
+    int Found = 0;
+    /* status of the replayed log, read by the master */
+    int ReplayStatus = C_SUCCESS;
+    /* slowdown of this node, every integrand is stretched by it (--slow-rank) */
+    double Slowdown = 1;
+    bool SlowdownGiven = false, ThreadsGiven = false;
+    int CommSize = ThreadInfo->Transport.Size;
+    int ProcRank = ThreadInfo->Transport.Rank;
+
+    if (argc < 5) {
+        DLOG(C_ERROR, "Invalid no of arguments for integration\n");
+        return C_INVALID_ARGS;
+    }
+
+    ThreadInfo->LowerBound  = atof (argv[1]);
+    ThreadInfo->UpperBound  = atof (argv[2]);
+    ThreadInfo->NoOfPoints  = atol (argv[3]);
+    ThreadInfo->StartIndex = 0;
+    ThreadInfo->StopIndex = 0;
+    ThreadInfo->CompletedIndex = 0;
+    ThreadInfo->RefineCachePath = NULL;
+    ThreadInfo->ReuseStride = 0;
+    memset (ThreadInfo->ReuseRawSum, 0, sizeof(ThreadInfo->ReuseRawSum));
+    ThreadInfo->NoOfTrials = 1;
+    ThreadInfo->NoOfWarmups = 0;
+    ThreadInfo->AffinityLayout = AFFINITY_NONE;
+    ThreadInfo->WorkStealing = false;
+    ThreadInfo->SpeculativeBackup = false;
+    ThreadInfo->StaticFraction = HYBRID_STATIC_FRACTION;
+    ThreadInfo->StaticPoints = 0;
+    ThreadInfo->RecordPath = NULL;
+    ThreadInfo->ReplayPath = NULL;
+    ThreadInfo->Elastic.MaxWorkers = 0;
+    ThreadInfo->Elastic.Backlog = ELASTIC_BACKLOG;
+    ThreadInfo->JobArgv = argv;
+    ThreadInfo->DumpPath = NULL;
+    ThreadInfo->Dump.File = MPI_FILE_NULL;
+    ThreadInfo->Dump.WithX = true;
+    ThreadInfo->DispatchOrder = DISPATCH_ORDER_INDEX;
+    ThreadInfo->Metrics.Target = NULL;
+    ThreadInfo->Metrics.Interval = 1;
+    ThreadInfo->Metrics.Format = METRICS_FORMAT_PROM;
+
+    for (int Arg = 5; Arg < argc; Arg++) {
+        if (strcmp (argv[Arg], "--refine") == 0 && Arg + 1 < argc) {
+            ThreadInfo->RefineCachePath = argv[++Arg];
+        }else if (strcmp (argv[Arg], "--sched") == 0 && Arg + 1 < argc) {
+            Sched = argv[++Arg];
+            SchedGiven = true;
+        }else if (strcmp (argv[Arg], "--granularity") == 0 && Arg + 1 < argc) {
+            Granularity = atol (argv[++Arg]);
+            if (Granularity < 1) {
+                DLOG(C_ERROR, "Invalid granularity %s\n", argv[Arg]);
+                return C_INVALID_ARGS;
+            }
+        }else if (strcmp (argv[Arg], "--prefetch") == 0 && Arg + 1 < argc) {
+            PrefetchDepth = atoi (argv[++Arg]);
+            if (PrefetchDepth < 1 || PrefetchDepth > MAX_CHUNK) {
+                DLOG(C_ERROR, "Invalid prefetch depth %s, at most %d\n", argv[Arg], MAX_CHUNK);
+                return C_INVALID_ARGS;
+            }
+        }else if (strcmp (argv[Arg], "--tuning") == 0 && Arg + 1 < argc) {
+            TuningPath = argv[++Arg];
+        }else if (strcmp (argv[Arg], "--static-fraction") == 0 && Arg + 1 < argc) {
+            Arg++;
+            ThreadInfo->StaticFraction = (strcmp (argv[Arg], "auto") == 0) ? -1 : atof (argv[Arg]);
+            if (ThreadInfo->StaticFraction != -1 && (ThreadInfo->StaticFraction < 0 || ThreadInfo->StaticFraction > 1)) {
+                DLOG(C_ERROR, "Invalid static fraction %s\n", argv[Arg]);
+                return C_INVALID_ARGS;
+            }
+        }else if (strcmp (argv[Arg], "--repeat") == 0 && Arg + 1 < argc) {
+            ThreadInfo->NoOfTrials = atoi (argv[++Arg]);
+        }else if (strcmp (argv[Arg], "--warmup") == 0 && Arg + 1 < argc) {
+            ThreadInfo->NoOfWarmups = atoi (argv[++Arg]);
+        }else if (strcmp (argv[Arg], "--affinity") == 0 && Arg + 1 < argc) {
+            if (AffinityParse (argv[++Arg], &ThreadInfo->AffinityLayout) != C_SUCCESS) {
+                DLOG(C_ERROR, "Invalid affinity layout %s\n", argv[Arg]);
+                return C_INVALID_ARGS;
+            }
+        }else if (strcmp (argv[Arg], "--slow-rank") == 0 && Arg + 1 < argc) {
+            if (SynthParseSlowdown (argv[++Arg], ProcRank, &Slowdown) != C_SUCCESS) {
+                DLOG(C_ERROR, "Invalid slowdown %s\n", argv[Arg]);
+                return C_INVALID_ARGS;
+            }
+            SlowdownGiven = true;
+        }else if (strcmp (argv[Arg], "--threads") == 0 && Arg + 1 < argc) {
+            /* the threads have been started by main */
+            Arg++;
+            ThreadsGiven = true;
+        }else if (strcmp (argv[Arg], "--steal") == 0) {
+            ThreadInfo->WorkStealing = true;
+        }else if (strcmp (argv[Arg], "--backup") == 0) {
+            ThreadInfo->SpeculativeBackup = true;
+        }else if (strcmp (argv[Arg], "--record") == 0 && Arg + 1 < argc) {
+            ThreadInfo->RecordPath = argv[++Arg];
+        }else if (strcmp (argv[Arg], "--replay") == 0 && Arg + 1 < argc) {
+            ThreadInfo->ReplayPath = argv[++Arg];
+        }else if (strcmp (argv[Arg], "--elastic") == 0 && Arg + 1 < argc) {
+            ThreadInfo->Elastic.MaxWorkers = atoi (argv[++Arg]);
+            if (ThreadInfo->Elastic.MaxWorkers < 0 || CommSize + ThreadInfo->Elastic.MaxWorkers > MAX_PROCESSORS) {
+                DLOG(C_ERROR, "Invalid no of workers %s, at most %d nodes in all\n", argv[Arg], MAX_PROCESSORS);
+                return C_INVALID_ARGS;
+            }
+        }else if (strcmp (argv[Arg], "--elastic-backlog") == 0 && Arg + 1 < argc) {
+            ThreadInfo->Elastic.Backlog = atof (argv[++Arg]);
+            if (ThreadInfo->Elastic.Backlog < 0) {
+                DLOG(C_ERROR, "Invalid backlog %s\n", argv[Arg]);
+                return C_INVALID_ARGS;
+            }
+        }else if (strcmp (argv[Arg], "--dump") == 0 && Arg + 1 < argc) {
+            ThreadInfo->DumpPath = argv[++Arg];
+        }else if (strcmp (argv[Arg], "--dump-format") == 0 && Arg + 1 < argc) {
+            if (SampleDumpParseFormat (argv[++Arg], &ThreadInfo->Dump.WithX) != C_SUCCESS) {
+                DLOG(C_ERROR, "Invalid dump format %s\n", argv[Arg]);
+                return C_INVALID_ARGS;
+            }
+        }else if (strcmp (argv[Arg], "--order") == 0 && Arg + 1 < argc) {
+            if (CostOrderParse (argv[++Arg], &ThreadInfo->DispatchOrder) != C_SUCCESS) {
+                DLOG(C_ERROR, "Invalid dispatch order %s\n", argv[Arg]);
+                return C_INVALID_ARGS;
+            }
+        }else if (strcmp (argv[Arg], "--metrics") == 0 && Arg + 1 < argc) {
+            ThreadInfo->Metrics.Target = argv[++Arg];
+        }else if (strcmp (argv[Arg], "--metrics-interval") == 0 && Arg + 1 < argc) {
+            ThreadInfo->Metrics.Interval = atof (argv[++Arg]);
+        }else if (strcmp (argv[Arg], "--metrics-format") == 0 && Arg + 1 < argc) {
+            if (MetricsParseFormat (argv[++Arg], &ThreadInfo->Metrics.Format) != C_SUCCESS) {
+                DLOG(C_ERROR, "Invalid metrics format %s\n", argv[Arg]);
+                return C_INVALID_ARGS;
+            }
+        }else {
+            DLOG(C_ERROR, "Invalid option %s\n", argv[Arg]);
+            return C_INVALID_ARGS;
+        }
+    }
+
+    if (ThreadInfo->NoOfTrials < 1 || ThreadInfo->NoOfTrials > MAX_TRIALS || ThreadInfo->NoOfWarmups < 0) {
+        DLOG(C_ERROR, "Invalid no of trials\n");
+        return C_INVALID_ARGS;
+    }
+
+    /* a stolen chunk is reported by the thief, which breaks the per slave order of the results */
+    if (ThreadInfo->WorkStealing && ThreadInfo->SpeculativeBackup) {
+        DLOG(C_ERROR, "--steal & --backup can not be combined\n");
+        return C_INVALID_ARGS;
+    }
+
+    /* the order of the results of a slave tells which chunk they belong to, which the thieves break.
+     * a replay hands out every chunk once, there is no copy to be made */
+    if (ThreadInfo->WorkStealing && (ThreadInfo->RecordPath != NULL || ThreadInfo->ReplayPath != NULL)) {
+        DLOG(C_ERROR, "--steal can not be combined with --record or --replay\n");
+        return C_INVALID_ARGS;
+    }
+    if (ThreadInfo->SpeculativeBackup && ThreadInfo->ReplayPath != NULL) {
+        DLOG(C_ERROR, "--backup & --replay can not be combined\n");
+        return C_INVALID_ARGS;
+    }
+    /* the replayed log fixes the order of the chunks */
+    if (ThreadInfo->DispatchOrder == DISPATCH_ORDER_LPT && ThreadInfo->ReplayPath != NULL) {
+        DLOG(C_ERROR, "--order lpt & --replay can not be combined\n");
+        return C_INVALID_ARGS;
+    }
+    /* a worker only knows the master, & only the chunks of the master are passed to it */
+    if (ThreadInfo->Elastic.MaxWorkers > 0 && (ThreadInfo->WorkStealing || ThreadInfo->SpeculativeBackup ||
+                ThreadInfo->RecordPath != NULL || ThreadInfo->ReplayPath != NULL ||
+                ThreadInfo->RefineCachePath != NULL)) {
+        DLOG(C_ERROR, "--elastic can not be combined with --steal, --backup, --record, --replay or --refine\n");
+        return C_INVALID_ARGS;
+    }
+    /* the refinement mode skips the cached points, & a worker has no handle on the file */
+    if (ThreadInfo->DumpPath != NULL && (ThreadInfo->RefineCachePath != NULL || ThreadInfo->Elastic.MaxWorkers > 0)) {
+        DLOG(C_ERROR, "--dump can not be combined with --refine or --elastic\n");
+        return C_INVALID_ARGS;
+    }
+
+    if (ThreadInfo->Metrics.Interval <= 0) {
+        DLOG(C_ERROR, "Invalid metrics interval\n");
+        return C_INVALID_ARGS;
+    }
 
-    if (ThreadInfo.NoOfPoints < 1000) {
+    /* the nodes are only pinned at startup, the layout of a request would never be applied */
+    if (!CommandLine && ThreadInfo->AffinityLayout != AFFINITY_NONE) {
+        DLOG(C_ERROR, "--affinity is only valid on the command line\n");
+        return C_INVALID_ARGS;
+    }
+
+    /* the threads only pass the messages of the master-worker protocol, & share the process */
+    if (ThreadsGiven != (ThreadInfo->Transport.Kind == TRANSPORT_THREADS)) {
+        DLOG(C_ERROR, "--threads is only valid on the command line\n");
+        return C_INVALID_ARGS;
+    }
+    if (ThreadsGiven && (ThreadInfo->WorkStealing || ThreadInfo->Elastic.MaxWorkers > 0 ||
+                ThreadInfo->DumpPath != NULL || SlowdownGiven)) {
+        DLOG(C_ERROR, "--threads can not be combined with --steal, --elastic, --dump or --slow-rank\n");
+        return C_INVALID_ARGS;
+    }
+
+    if (ThreadInfo->NoOfPoints < 1000) {
         DLOG(C_ERROR, "Invalid 'no of points' input for integration."
                 "This implementation needs 'no of points' to be more than or equal to 1000\n");
-        goto EXIT;
+        return C_INVALID_ARGS;
+    }
+
+    /* the master only hands out the work, a spawned worker parses the job alone */
+    if (CommSize < 2 && Comm != MPI_COMM_SELF) {
+        DLOG(C_ERROR, "A job needs at least 2 nodes, the master & a slave\n");
+        return C_INVALID_ARGS;
+    }
+
+    /* the policy tuned for this configuration replaces the default one, only the master reads the file */
+    if (!SchedGiven && strcmp (TuningPath, "none") != 0) {
+        if (ProcRank == MASTER_NODE) {
+            Found = (TuningLookup (TuningPath, argv[0], argv[4], ThreadInfo->NoOfPoints, CommSize,
+                        NULL, &Tuned) == C_SUCCESS &&
+                    !(ThreadInfo->WorkStealing && strcmp (Tuned.Sched, "hybrid") == 0));
+        }
+        TransportBcast (&ThreadInfo->Transport, &Found, sizeof(Found), MASTER_NODE);
+        if (Found) {
+            TransportBcast (&ThreadInfo->Transport, &Tuned, sizeof(Tuned), MASTER_NODE);
+            Sched = Tuned.Sched;
+            DLOG (C_VERBOSE, "Node[%d] tuned policy %s, granularity %ld, prefetch depth %d\n", ProcRank,
+                    Tuned.Sched, Tuned.Granularity, Tuned.PrefetchDepth);
+        }
     }
-    if (ThreadInfo.NoOfPoints < 10000) {
-        /* calculation : MAX_CHUNK * MAX_PROCESSORS * Granularity < NoOfPoints */
-        ThreadInfo.Granularity = 10;
+
+    /* all three schedulers are served by the same master-worker protocol,
+     * only the chunk size & the no of chunks queued at a slave differ */
+    if (strcmp (Sched, "advnc") == 0) {
+        ThreadInfo->PrefetchDepth = DEFAULT_PREFETCH_DEPTH;
+        if (ThreadInfo->NoOfPoints < 10000) {
+            /* calculation : DEFAULT_PREFETCH_DEPTH * MAX_PROCESSORS * Granularity < NoOfPoints */
+            ThreadInfo->Granularity = 10;
+        }else {
+            /* based on multiple runs of the program,
+             * a granularuty of 100 was found to satisfy most of the cases */
+            ThreadInfo->Granularity = 100;
+        }
+    }else if (strcmp (Sched, "hybrid") == 0) {
+        /* the remainder is served like the advanced scheduler */
+        ThreadInfo->PrefetchDepth = DEFAULT_PREFETCH_DEPTH;
+        ThreadInfo->Granularity = (ThreadInfo->NoOfPoints < 10000) ? 10 : 100;
+    }else if (strcmp (Sched, "dynamic") == 0) {
+        ThreadInfo->PrefetchDepth = 1;
+        ThreadInfo->Granularity = 100;
+    }else if (strcmp (Sched, "static") == 0) {
+        /* one contiguous block of N/P iterations per slave */
+        ThreadInfo->PrefetchDepth = 1;
+        ThreadInfo->Granularity = (ThreadInfo->NoOfPoints + CommSize - 2) / std::max (1, CommSize - 1);
     }else {
-        /* based on multiple runs of the program,
-         * a granularuty of 100 was found to satisfy most of the cases */
-        ThreadInfo.Granularity = 100;
+        DLOG(C_ERROR, "Invalid scheduler %s\n", Sched);
+        return C_INVALID_ARGS;
+    }
+    /* the block size of the static scheduler follows from the no of nodes */
+    if (Found && strcmp (Sched, "static") != 0) {
+        ThreadInfo->Granularity = std::max (1L, Tuned.Granularity);
+        ThreadInfo->PrefetchDepth = std::max (1, std::min (Tuned.PrefetchDepth, MAX_CHUNK));
+    }
+    if (Granularity > 0) {
+        ThreadInfo->Granularity = Granularity;
+    }
+    if (PrefetchDepth > 0) {
+        ThreadInfo->PrefetchDepth = PrefetchDepth;
+    }
+    if (strcmp (Sched, "hybrid") != 0) {
+        ThreadInfo->StaticFraction = 0;
+    }else if (ThreadInfo->WorkStealing) {
+        /* the static blocks are reported on exit, which the work stealing mode does not do */
+        DLOG(C_ERROR, "--sched hybrid & --steal can not be combined\n");
+        return C_INVALID_ARGS;
+    }
+
+    /* based on the input argument, select suitable functions to integrate */
+    if (ParseIntegrands (argv[0], argv[4], ThreadInfo->Integrands, &ThreadInfo->NoOfIntegrands) != C_SUCCESS) {
+        DLOG(C_ERROR, "Invalid function input for integration\n");
+        return C_INVALID_ARGS;
+    }
+    /* the threads share the configuration of the synthetic integrands, the master sets it up */
+    if (!ThreadsGiven || ProcRank == MASTER_NODE) {
+        SynthConfigure (ThreadInfo->LowerBound, ThreadInfo->UpperBound, Slowdown);
+    }
+    if (ThreadsGiven) {
+        TransportBarrier (&ThreadInfo->Transport);
+    }
+
+    /* the replayed log fixes the static prefix, the slaves only need to know its size */
+    if (ThreadInfo->ReplayPath != NULL) {
+        if (ProcRank == MASTER_NODE) {
+            ReplayStatus = DecisionLogRead (&ThreadInfo->Replay, ThreadInfo->ReplayPath);
+            if (ReplayStatus == C_SUCCESS) {
+                ReplayStatus = DecisionLogCheck (&ThreadInfo->Replay, CommSize, ThreadInfo->NoOfPoints);
+                ThreadInfo->StaticPoints = ThreadInfo->Replay.Header.StaticPoints;
+                if (ReplayStatus != C_SUCCESS) {
+                    DecisionLogFree (&ThreadInfo->Replay);
+                }
+            }
+        }
+        TransportBcast (&ThreadInfo->Transport, &ReplayStatus, sizeof(ReplayStatus), MASTER_NODE);
+        if (ReplayStatus != C_SUCCESS) {
+            DLOG(C_ERROR, "Unable to replay %s with %d nodes & %ld points\n", ThreadInfo->ReplayPath,
+                    CommSize, ThreadInfo->NoOfPoints);
+            return C_INVALID_ARGS;
+        }
+        TransportBcast (&ThreadInfo->Transport, &ThreadInfo->StaticPoints, sizeof(ThreadInfo->StaticPoints), MASTER_NODE);
+    }
+
+    return C_SUCCESS;
+}
+
+/*==============================================================================
+ *  RunJob
+ *=============================================================================*/
+
+/*
+ * run a single integration on all the nodes, repeated as requested.
+ * the result of the last trial & the median time are left on the master,
+ * the phase timers on every node.
+ */
+static void RunJob (void * inArg)
+{
+    RefThreadData ThreadInfo = (RefThreadData)inArg;
+    int Trial;
+    int CommSize = ThreadInfo->Transport.Size;
+    int ProcRank = ThreadInfo->Transport.Rank;
+    double TrialTimes[MAX_TRIALS];
+    double ProbeTimes[COST_ORDER_BUCKETS];
+
+    ThreadInfo->Timer.NoOfTrials = 0;
+
+    if (ThreadInfo->RefineCachePath != NULL) {
+        /* only the master reads the cache, the slaves just need to know what to skip */
+        if (ProcRank == MASTER_NODE){
+            RefineSetup(ThreadInfo);
+        }
+        TransportBcast (&ThreadInfo->Transport, &ThreadInfo->ReuseStride, sizeof(ThreadInfo->ReuseStride), MASTER_NODE);
+    }
+
+    if (ThreadInfo->Elastic.MaxWorkers > 0) {
+        ElasticInstallSignals ();
+    }
+
+    if (ThreadInfo->ReplayPath == NULL) {
+        if (ThreadInfo->StaticFraction == -1) {
+            HybridCalibrate (ThreadInfo);
+        }
+        ThreadInfo->StaticPoints = (long) (ThreadInfo->StaticFraction * ThreadInfo->NoOfPoints);
+    }
+
+    /* the cost of the range served by the master is sampled once for all the trials */
+    if (ThreadInfo->DispatchOrder == DISPATCH_ORDER_LPT) {
+        CostOrderInit (&ThreadInfo->Order, ThreadInfo->StaticPoints, ThreadInfo->NoOfPoints - ThreadInfo->StaticPoints,
+                ThreadInfo->Granularity);
+        CostOrderProbe (&ThreadInfo->Order, ProcRank - 1, CommSize - 1, ThreadInfo->Integrands,
+                ThreadInfo->NoOfIntegrands, ThreadInfo->LowerBound, ThreadInfo->UpperBound, ThreadInfo->NoOfPoints,
+                ProbeTimes);
+        TransportReduce (&ThreadInfo->Transport, ProbeTimes, ThreadInfo->Order.Cost, ThreadInfo->Order.NoOfBuckets,
+                TRANSPORT_MIN, MASTER_NODE);
+        if (ProcRank == MASTER_NODE) {
+            CostOrderSort (&ThreadInfo->Order);
+        }
+    }
+
+    /* opened after the calibration, whose probe chunk is not part of the grid. every trial rewrites it */
+    if (ThreadInfo->DumpPath != NULL &&
+            SampleDumpOpen (&ThreadInfo->Dump, ThreadInfo->Comm, MASTER_NODE, ThreadInfo->DumpPath,
+                ThreadInfo->NoOfPoints, ThreadInfo->NoOfIntegrands, ThreadInfo->LowerBound,
+                ThreadInfo->UpperBound) != C_SUCCESS && ProcRank == MASTER_NODE) {
+        DLOG(C_ERROR, "Unable to write %s, the samples are not dumped\n", ThreadInfo->DumpPath);
+    }
+
+    for (Trial = 0; Trial < ThreadInfo->NoOfWarmups + ThreadInfo->NoOfTrials; Trial++) {
+
+        ThreadInfo->StartIndex = 0;
+        ThreadInfo->StopIndex = 0;
+        /* the master serves only what follows the static blocks */
+        ThreadInfo->CompletedIndex = ThreadInfo->StaticPoints;
+        if (ThreadInfo->DispatchOrder == DISPATCH_ORDER_LPT) {
+            CostOrderRewind (&ThreadInfo->Order);
+        }
+        for (int Slot = 0; Slot < BACKUP_CANCEL_LEN; Slot++) {
+            ThreadInfo->CancelledChunks[Slot] = -1;
+        }
+        ThreadInfo->CancelSlot = 0;
+        PhaseTimerBeginTrial (&ThreadInfo->Timer);
+
+        TransportBarrier (&ThreadInfo->Transport);
+
+        if (ProcRank == MASTER_NODE){
+            MasterWork(ThreadInfo);
+            if (Trial >= ThreadInfo->NoOfWarmups) {
+                TrialTimes[Trial - ThreadInfo->NoOfWarmups] = ThreadInfo->ElapsedTime;
+            }
+        }else if (ThreadInfo->WorkStealing) {
+            SlaveStealWork(ThreadInfo);
+        }else{
+            SlaveWork(ThreadInfo);
+        }
+
+        PhaseTimerEndTrial (&ThreadInfo->Timer, Trial >= ThreadInfo->NoOfWarmups);
+    }
+
+    SampleDumpClose (&ThreadInfo->Dump);
+    if (ThreadInfo->DispatchOrder == DISPATCH_ORDER_LPT) {
+        CostOrderFree (&ThreadInfo->Order);
+    }
+
+    if (ProcRank == MASTER_NODE){
+        ThreadInfo->ElapsedTime = PhaseTimerMedian (TrialTimes, ThreadInfo->NoOfTrials);
+        if (ThreadInfo->RefineCachePath != NULL) {
+            RefineFinish(ThreadInfo);
+        }
+        if (ThreadInfo->ReplayPath != NULL) {
+            DecisionLogFree (&ThreadInfo->Replay);
+        }
+    }
+}
+
+/*
+ * 1. the master listens on a UNIX domain socket, the slaves wait in MPI_Bcast
+ * 2. a client sends one request per line, in the same format as the command line :
+ *    "<FunctionID> <LowerBound> <UpperBound> <NoOfPoints> <Intensity> [options]"
+ * 3. the master broadcasts the request line, every node parses it & runs the job
+ * 4. the master replies "<result> [<result> ...] <time>" or "error" on the same connection,
+ *    with --refine each result is followed by the extrapolated estimate & its error
+ * 5. a "quit" request shuts down the daemon
+ */
+
+/*==============================================================================
+ *  DaemonWork
+ *=============================================================================*/
+
+static void DaemonWork (const char * SocketPath)
+{
+    int ProcRank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &ProcRank);
+
+    ThreadData ThreadInfo;
+    char Request[DAEMON_REQUEST_LEN];
+    char * JobArgv[DAEMON_MAX_ARGS];
+    int JobArgc;
+    CStatus C_Status;
+
+    int ListenFd = -1;
+    /* separate streams, as a stream may not switch from reading to writing */
+    FILE * Client = NULL;
+    FILE * ClientOut = NULL;
+    struct sockaddr_un Addr;
+
+    if (ProcRank == MASTER_NODE) {
+        /* a client going away before its reply must not kill the daemon, the write fails instead */
+        signal (SIGPIPE, SIG_IGN);
+
+        memset (&Addr, 0, sizeof(Addr));
+        Addr.sun_family = AF_UNIX;
+        strncpy (Addr.sun_path, SocketPath, sizeof(Addr.sun_path) - 1);
+        unlink (SocketPath);
+
+        ListenFd = socket (AF_UNIX, SOCK_STREAM, 0);
+        if (ListenFd < 0 || bind (ListenFd, (struct sockaddr *)&Addr, sizeof(Addr)) != 0 ||
+                listen (ListenFd, 8) != 0) {
+            DLOG(C_ERROR, "Unable to listen on %s\n", SocketPath);
+            /* tell the slaves to quit */
+            strcpy (Request, "quit");
+        }else {
+            DLOG(C_INFO, "Node[master] daemon listening on %s\n", SocketPath);
+            Request[0] = '\0';
+        }
+    }
+
+    while (1) {
+
+        if (ProcRank == MASTER_NODE && strcmp (Request, "quit") != 0) {
+            /* wait for the next request, one connection may carry many requests */
+            while (1) {
+                if (Client == NULL) {
+                    int ClientFd = accept (ListenFd, NULL, NULL);
+                    if (ClientFd < 0) {
+                        continue;
+                    }
+                    Client = fdopen (ClientFd, "r");
+                    ClientOut = fdopen (dup (ClientFd), "w");
+                }
+                if (fgets (Request, sizeof(Request), Client) != NULL) {
+                    Request[strcspn (Request, "\r\n")] = '\0';
+                    if (Request[0] != '\0') {
+                        break;
+                    }
+                }else {
+                    fclose (ClientOut);
+                    fclose (Client);
+                    Client = NULL;
+                }
+            }
+        }
+
+        MPI_Bcast (Request, DAEMON_REQUEST_LEN, MPI_CHAR, MASTER_NODE, MPI_COMM_WORLD);
+
+        if (strcmp (Request, "quit") == 0) {
+            DLOG (C_VERBOSE, "Node[%d] quit request received. daemon exiting\n", ProcRank);
+            break;
+        }
+
+        /* every node tokenizes its own copy of the request, so they all agree on the job */
+        JobArgc = SplitRequest (Request, JobArgv);
+
+        C_Status = ParseJob (JobArgc, JobArgv, MPI_COMM_WORLD, false, &ThreadInfo);
+        if (C_Status == C_SUCCESS) {
+            RunJob (&ThreadInfo);
+        }
+
+        if (ProcRank == MASTER_NODE) {
+            if (C_Status == C_SUCCESS) {
+                WriteJobResult (ClientOut, &ThreadInfo);
+            }else {
+                fprintf (ClientOut, "error %d\n", C_Status);
+            }
+            /* the client has gone, wait for the next one */
+            if (fflush (ClientOut) != 0 || ferror (ClientOut)) {
+                DLOG(C_ERROR, "Unable to reply to the client\n");
+                fclose (ClientOut);
+                fclose (Client);
+                Client = NULL;
+            }
+        }
+        if (C_Status == C_SUCCESS && ThreadInfo.NoOfWarmups + ThreadInfo.NoOfTrials > 1) {
+            PhaseTimerReport (&ThreadInfo.Timer, MPI_COMM_WORLD, MASTER_NODE, stdout);
+        }
+    }
+
+    if (ProcRank == MASTER_NODE) {
+        if (Client != NULL) {
+            fprintf (ClientOut, "bye\n");
+            fclose (ClientOut);
+            fclose (Client);
+        }
+        if (ListenFd >= 0) {
+            close (ListenFd);
+            unlink (SocketPath);
+        }
+    }
+}
+
+/*
+ * 1. the master of MPI_COMM_WORLD reads the job list, one job per line in the
+ *    request format of the daemon, & broadcasts it. a job may ask for its own
+ *    no of nodes with "--ranks <Nodes>", the others get GroupSize nodes.
+ * 2. the jobs are packed in order into waves which fit in MPI_COMM_WORLD
+ * 3. for every wave, MPI_COMM_WORLD is split into one group per job, the
+ *    nodes left over sit the wave out
+ * 4. every group runs its job with its own master & the master of the group
+ *    prints "<JobNo> <result> [<result> ...] <time>" or "<JobNo> error"
+ * 5. the master of MPI_COMM_WORLD reports the throughput in jobs/hour
+ */
+
+/*==============================================================================
+ *  JobListWork
+ *=============================================================================*/
+
+static void JobListWork (const char * JobPath, int GroupSize)
+{
+    int CommSize, ProcRank, GroupRank;
+    MPI_Comm_size(MPI_COMM_WORLD, &CommSize);
+    MPI_Comm_rank(MPI_COMM_WORLD, &ProcRank);
+
+    ThreadData ThreadInfo;
+    char (* Jobs)[DAEMON_REQUEST_LEN] = new char [MAX_JOBS][DAEMON_REQUEST_LEN];
+    char Request[DAEMON_REQUEST_LEN];
+    char * JobArgv[DAEMON_MAX_ARGS];
+    int JobRanks[MAX_JOBS];
+    int NoOfJobs = 0, JobArgc, Job, WaveStart, WaveEnd, FirstRank, Color, Arg;
+    CStatus C_Status;
+    MPI_Comm GroupComm;
+    FILE * JobFile;
+
+    std::chrono::time_point<std::chrono::steady_clock> StartTime;
+    std::chrono::duration<double> ElapsedTime;
+
+    if (ProcRank == MASTER_NODE) {
+        JobFile = fopen (JobPath, "r");
+        if (JobFile == NULL) {
+            DLOG(C_ERROR, "Unable to open %s\n", JobPath);
+        }else {
+            while (NoOfJobs < MAX_JOBS && fgets (Jobs[NoOfJobs], DAEMON_REQUEST_LEN, JobFile) != NULL) {
+                Jobs[NoOfJobs][strcspn (Jobs[NoOfJobs], "\r\n")] = '\0';
+                /* skip blank lines & comments */
+                if (Jobs[NoOfJobs][strspn (Jobs[NoOfJobs], " \t")] != '\0' && Jobs[NoOfJobs][0] != '#') {
+                    NoOfJobs++;
+                }
+            }
+            fclose (JobFile);
+        }
+    }
+    MPI_Bcast (&NoOfJobs, 1, MPI_INT, MASTER_NODE, MPI_COMM_WORLD);
+    MPI_Bcast (Jobs, NoOfJobs * DAEMON_REQUEST_LEN, MPI_CHAR, MASTER_NODE, MPI_COMM_WORLD);
+
+    /* no group of a master & a slave fits */
+    if (CommSize < 2) {
+        DLOG(C_ERROR, "A job needs at least 2 nodes, the master & a slave\n");
+        for (Job = 0; Job < NoOfJobs; Job++) {
+            printf ("%d error %d\n", Job, C_INVALID_ARGS);
+        }
+        fflush (stdout);
+        delete[] Jobs;
+        return;
+    }
+
+    if (GroupSize <= 0) {
+        /* share the nodes evenly between the jobs */
+        GroupSize = (NoOfJobs > 0) ? CommSize / NoOfJobs : CommSize;
+    }
+
+    /* every node works out the same group sizes */
+    for (Job = 0; Job < NoOfJobs; Job++) {
+        JobRanks[Job] = GroupSize;
+        strcpy (Request, Jobs[Job]);
+        JobArgc = SplitRequest (Request, JobArgv);
+        for (Arg = 0; Arg + 1 < JobArgc; Arg++) {
+            if (strcmp (JobArgv[Arg], "--ranks") == 0) {
+                JobRanks[Job] = atoi (JobArgv[Arg + 1]);
+            }
+        }
+        /* a master & at least one slave */
+        JobRanks[Job] = std::max (2, std::min (JobRanks[Job], CommSize));
+    }
+
+    StartTime = std::chrono::steady_clock::now();
+
+    for (WaveStart = 0; WaveStart < NoOfJobs; WaveStart = WaveEnd) {
+
+        /* pack the following jobs as long as they fit */
+        Color = MPI_UNDEFINED;
+        FirstRank = 0;
+        for (WaveEnd = WaveStart; WaveEnd < NoOfJobs && FirstRank + JobRanks[WaveEnd] <= CommSize; WaveEnd++) {
+            if (ProcRank >= FirstRank && ProcRank < FirstRank + JobRanks[WaveEnd]) {
+                Color = WaveEnd;
+            }
+            FirstRank += JobRanks[WaveEnd];
+        }
+        /* every job fits in MPI_COMM_WORLD, an empty wave would be split again & again */
+        if (WaveEnd == WaveStart) {
+            DLOG(C_ERROR, "Job %d does not fit in %d nodes\n", WaveStart, CommSize);
+            if (ProcRank == MASTER_NODE) {
+                for (Job = WaveStart; Job < NoOfJobs; Job++) {
+                    printf ("%d error %d\n", Job, C_FAILURE);
+                }
+                fflush (stdout);
+            }
+            break;
+        }
+
+        MPI_Comm_split (MPI_COMM_WORLD, Color, ProcRank, &GroupComm);
+        if (Color == MPI_UNDEFINED) {
+            continue;
+        }
+        MPI_Comm_rank(GroupComm, &GroupRank);
+
+        /* the arguments of the job without --ranks */
+        strcpy (Request, Jobs[Color]);
+        JobArgc = SplitRequest (Request, JobArgv);
+        for (Arg = 0; Arg + 1 < JobArgc; Arg++) {
+            if (strcmp (JobArgv[Arg], "--ranks") == 0) {
+                memmove (&JobArgv[Arg], &JobArgv[Arg + 2], (JobArgc - Arg - 2) * sizeof(JobArgv[0]));
+                JobArgc -= 2;
+                break;
+            }
+        }
+
+        C_Status = ParseJob (JobArgc, JobArgv, GroupComm, false, &ThreadInfo);
+        if (C_Status == C_SUCCESS) {
+            RunJob (&ThreadInfo);
+        }
+
+        if (GroupRank == MASTER_NODE) {
+            /* a single write per job, so that the lines of the groups do not mix */
+            char Line[DAEMON_REQUEST_LEN * 4];
+            FILE * LineOut = fmemopen (Line, sizeof(Line), "w");
+            fprintf (LineOut, "%d ", Color);
+            if (C_Status == C_SUCCESS) {
+                WriteJobResult (LineOut, &ThreadInfo);
+            }else {
+                fprintf (LineOut, "error %d\n", C_Status);
+            }
+            fclose (LineOut);
+            fputs (Line, stdout);
+            fflush (stdout);
+        }
+
+        MPI_Comm_free (&GroupComm);
+    }
+
+    MPI_Barrier (MPI_COMM_WORLD);
+    ElapsedTime = std::chrono::steady_clock::now() - StartTime;
+
+    if (ProcRank == MASTER_NODE) {
+        printf ("# %d jobs in %.6g s, %.6g jobs/hour\n", NoOfJobs, ElapsedTime.count(),
+                (ElapsedTime.count() > 0) ? NoOfJobs * 3600 / ElapsedTime.count() : 0);
+        std::cerr<<ElapsedTime.count()<<std::endl;
+    }
+
+    delete[] Jobs;
+}
+
+/*
+ * 1. truncate the configuration to its first TunePoints points, with the same
+ *    grid spacing, i.e. a proportionally smaller upper bound
+ * 2. time the dynamic policy for every granularity, the advanced policy for
+ *    every granularity & then for every prefetch depth at the best granularity
+ * 3. time the hybrid policy with the best advanced settings & the static one
+ * 4. the master appends the best settings of every policy to the tuning file,
+ *    keyed by the full configuration
+ */
+
+/*==============================================================================
+ *  TuneWork
+ *=============================================================================*/
+
+static void TuneWork (const char * TuningPath, int argc, char * argv[])
+{
+    static const long Granularities[] = {10, 30, 100, 300, 1000, 3000, 10000};
+    static const int PrefetchDepths[] = {1, 2, 3, 4, 6, 8};
+    const int NoOfGranularities = sizeof(Granularities) / sizeof(Granularities[0]);
+    const int NoOfPrefetchDepths = sizeof(PrefetchDepths) / sizeof(PrefetchDepths[0]);
+
+    int CommSize, ProcRank;
+    MPI_Comm_size(MPI_COMM_WORLD, &CommSize);
+    MPI_Comm_rank(MPI_COMM_WORLD, &ProcRank);
+
+    char * JobArgv[DAEMON_MAX_ARGS];
+    char PointsArg[32], UpperBoundArg[32];
+    int JobArgc = 0, Arg, i;
+    long NoOfPoints = atol (argv[3]), TunePoints = TUNE_POINTS;
+    double LowerBound = atof (argv[1]), UpperBound = atof (argv[2]), Time;
+    TuningEntrySt Best[4];
+    const char * Policies[4] = {"dynamic", "advnc", "hybrid", "static"};
+
+    /* the job options are kept, but for the no of points of the tuning runs */
+    for (Arg = 0; Arg < argc && JobArgc < DAEMON_MAX_ARGS - 12; Arg++) {
+        if (strcmp (argv[Arg], "--tune-points") == 0 && Arg + 1 < argc) {
+            TunePoints = atol (argv[++Arg]);
+        }else {
+            JobArgv[JobArgc++] = argv[Arg];
+        }
+    }
+    TunePoints = std::min (TunePoints, NoOfPoints);
+    if (NoOfPoints < 1000 || TunePoints < 1000 || CommSize < 2) {
+        DLOG(C_ERROR, "Invalid configuration, at least 1000 points & 2 nodes are needed\n");
+        return;
+    }
+    snprintf (PointsArg, sizeof(PointsArg), "%ld", TunePoints);
+    snprintf (UpperBoundArg, sizeof(UpperBoundArg), "%.17g",
+            LowerBound + (UpperBound - LowerBound) * TunePoints / NoOfPoints);
+    JobArgv[2] = UpperBoundArg;
+    JobArgv[3] = PointsArg;
+
+    for (i = 0; i < 4; i++) {
+        strcpy (Best[i].Sched, Policies[i]);
+        Best[i].Granularity = 0;
+        Best[i].PrefetchDepth = 1;
+        Best[i].Time = 1e300;
+    }
+
+    /* every slave should get at least one chunk */
+    for (i = 0; i < NoOfGranularities; i++) {
+        if (i > 0 && Granularities[i] * (CommSize - 1) > TunePoints) {
+            break;
+        }
+        Time = TuneRun (JobArgc, JobArgv, "dynamic", Granularities[i], 1);
+        if (Time < Best[0].Time) {
+            Best[0].Granularity = Granularities[i];
+            Best[0].Time = Time;
+        }
+        Time = TuneRun (JobArgc, JobArgv, "advnc", Granularities[i], DEFAULT_PREFETCH_DEPTH);
+        if (Time < Best[1].Time) {
+            Best[1].Granularity = Granularities[i];
+            Best[1].PrefetchDepth = DEFAULT_PREFETCH_DEPTH;
+            Best[1].Time = Time;
+        }
+    }
+    for (i = 0; i < NoOfPrefetchDepths; i++) {
+        if (PrefetchDepths[i] == DEFAULT_PREFETCH_DEPTH || PrefetchDepths[i] > MAX_CHUNK) {
+            continue;
+        }
+        Time = TuneRun (JobArgc, JobArgv, "advnc", Best[1].Granularity, PrefetchDepths[i]);
+        if (Time < Best[1].Time) {
+            Best[1].PrefetchDepth = PrefetchDepths[i];
+            Best[1].Time = Time;
+        }
+    }
+    Best[2].Granularity = Best[1].Granularity;
+    Best[2].PrefetchDepth = Best[1].PrefetchDepth;
+    Best[2].Time = TuneRun (JobArgc, JobArgv, "hybrid", Best[1].Granularity, Best[1].PrefetchDepth);
+    Best[3].Time = TuneRun (JobArgc, JobArgv, "static", 0, 0);
+
+    if (ProcRank == MASTER_NODE) {
+        for (i = 0; i < 4; i++) {
+            printf ("# tuned %s granularity %ld prefetch depth %d : %.6g s\n", Best[i].Sched,
+                    Best[i].Granularity, Best[i].PrefetchDepth, Best[i].Time);
+            if (Best[i].Time < 1e300 &&
+                    TuningStore (TuningPath, argv[0], argv[4], NoOfPoints, CommSize, &Best[i]) != C_SUCCESS) {
+                DLOG(C_ERROR, "Unable to write %s\n", TuningPath);
+                break;
+            }
+        }
+        fflush (stdout);
+    }
+}
+
+/*==============================================================================
+ *  TuneRun
+ *=============================================================================*/
+
+/* median time of the tuning trials on every node, a huge time if the run is not possible */
+static double TuneRun (int argc, char * argv[], const char * Sched, long Granularity, int PrefetchDepth)
+{
+    int ProcRank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &ProcRank);
+
+    ThreadData ThreadInfo;
+    char * JobArgv[DAEMON_MAX_ARGS];
+    char SchedArg[TUNING_NAME_LEN], GranularityArg[32], PrefetchArg[32], TrialsArg[32];
+    int JobArgc = argc;
+    double Time = 1e300;
+
+    memcpy (JobArgv, argv, argc * sizeof(JobArgv[0]));
+    strncpy (SchedArg, Sched, sizeof(SchedArg) - 1);
+    SchedArg[sizeof(SchedArg) - 1] = '\0';
+    snprintf (TrialsArg, sizeof(TrialsArg), "%d", TUNE_TRIALS);
+    JobArgv[JobArgc++] = (char *) "--sched";
+    JobArgv[JobArgc++] = SchedArg;
+    JobArgv[JobArgc++] = (char *) "--warmup";
+    JobArgv[JobArgc++] = (char *) "1";
+    JobArgv[JobArgc++] = (char *) "--repeat";
+    JobArgv[JobArgc++] = TrialsArg;
+    if (Granularity > 0) {
+        snprintf (GranularityArg, sizeof(GranularityArg), "%ld", Granularity);
+        snprintf (PrefetchArg, sizeof(PrefetchArg), "%d", PrefetchDepth);
+        JobArgv[JobArgc++] = (char *) "--granularity";
+        JobArgv[JobArgc++] = GranularityArg;
+        JobArgv[JobArgc++] = (char *) "--prefetch";
+        JobArgv[JobArgc++] = PrefetchArg;
+    }
+
+    if (ParseJob (JobArgc, JobArgv, MPI_COMM_WORLD, false, &ThreadInfo) == C_SUCCESS) {
+        RunJob (&ThreadInfo);
+        Time = ThreadInfo.ElapsedTime;
+    }
+    /* every node takes the same decisions */
+    MPI_Bcast (&Time, 1, MPI_DOUBLE, MASTER_NODE, MPI_COMM_WORLD);
+
+    if (ProcRank == MASTER_NODE) {
+        printf ("# tune %s granularity %ld prefetch depth %d : %.6g s\n", Sched, Granularity,
+                PrefetchDepth, Time);
+        fflush (stdout);
+    }
+    return Time;
+}
+
+/*==============================================================================
+ *  ElasticWorkerWork
+ *=============================================================================*/
+
+/*
+ * a worker spawned by the master of a running job : it joins the master on a
+ * communicator of its own, runs the slave loop on it & leaves
+ */
+static void ElasticWorkerWork (int argc, char * argv[])
+{
+    ThreadData ThreadInfo;
+    MPI_Comm Parent, Comm;
+
+    MPI_Comm_get_parent (&Parent);
+    if (Parent == MPI_COMM_NULL) {
+        DLOG(C_ERROR, "%s is only used by the master of an elastic job\n", ELASTIC_WORKER_ARG);
+        return;
+    }
+    /* mpirun may forward the signals of the master to the workers too */
+    ElasticInstallSignals ();
+    MPI_Intercomm_merge (Parent, 1, &Comm);
+
+    /* the job is parsed alone, the options passed by the master need no collective call */
+    if (ParseJob (argc, argv, MPI_COMM_SELF, false, &ThreadInfo) == C_SUCCESS) {
+        ThreadInfo.Comm = Comm;
+        TransportInitMpi (&ThreadInfo.Transport, Comm);
+        ThreadInfo.Timer.NoOfTrials = 0;
+        PhaseTimerBeginTrial (&ThreadInfo.Timer);
+        SlaveWork (&ThreadInfo);
+        PhaseTimerEndTrial (&ThreadInfo.Timer, false);
+    }
+
+    MPI_Comm_free (&Comm);
+    MPI_Comm_disconnect (&Parent);
+}
+
+/*==============================================================================
+ *  ThreadsWork
+ *=============================================================================*/
+
+/*
+ * --threads <Slaves> runs the job like mpirun -n <Slaves + 1>, with the master
+ * & the slaves as threads of this process, 0 taking one thread per core up to
+ * MAX_PROCESSORS. every thread parses the job & runs it as a node would, its
+ * messages & collective calls going through the shared queues instead of MPI.
+ * with --affinity every thread pins itself before running the job.
+ */
+static void ThreadsWork (int argc, char * argv[])
+{
+    int Arg, Node, k, CommSize = 0;
+    RefTransportSharedSt Shared;
+    ThreadData * Nodes;
+    bool Parsed[MAX_PROCESSORS];
+    std::thread Slaves[MAX_PROCESSORS];
+    /* binding of every thread, printed like AffinityReport does */
+    char (* Bindings)[AFFINITY_DESC_LEN];
+
+    for (Arg = 5; Arg + 1 < argc; Arg++) {
+        if (strcmp (argv[Arg], "--threads") == 0) {
+            CommSize = atoi (argv[Arg + 1]);
+            if (CommSize == 0) {
+                CommSize = std::max (1, std::min ((int) std::thread::hardware_concurrency() - 1, MAX_PROCESSORS - 1));
+            }
+            CommSize++;
+        }
+    }
+    if (CommSize < 2 || CommSize > MAX_PROCESSORS) {
+        DLOG(C_ERROR, "Invalid no of threads, 1 to %d slaves\n", MAX_PROCESSORS - 1);
+        return;
+    }
+
+    Shared = TransportSharedCreate (CommSize);
+    Nodes = new ThreadData [CommSize];
+    Bindings = new char [CommSize][AFFINITY_DESC_LEN];
+
+    auto NodeWork = [&] (int Node) {
+        TransportInitThread (&Nodes[Node].Transport, Shared, Node);
+        Parsed[Node] = (ParseJob (argc, argv, MPI_COMM_NULL, true, &Nodes[Node]) == C_SUCCESS);
+        if (Parsed[Node] && Nodes[Node].AffinityLayout != AFFINITY_NONE) {
+            /* the cores are ordered once, before any thread pins itself */
+            if (Node == MASTER_NODE && AffinityOrderThreads (Nodes[Node].AffinityLayout) != C_SUCCESS) {
+                DLOG(C_ERROR, "Unable to order the cores of this process\n");
+            }
+            TransportBarrier (&Nodes[Node].Transport);
+            AffinityBindThread (Nodes[Node].AffinityLayout, Node);
+            AffinityDescribe (Bindings[Node]);
+        }
+        if (Parsed[Node]) {
+            RunJob (&Nodes[Node]);
+        }
+    };
+    for (Node = 1; Node < CommSize; Node++) {
+        Slaves[Node] = std::thread (NodeWork, Node);
+    }
+    NodeWork (MASTER_NODE);
+    for (Node = 1; Node < CommSize; Node++) {
+        Slaves[Node].join ();
+    }
+
+    /* displayed as by main */
+    if (Parsed[MASTER_NODE]) {
+        RefThreadData ThreadInfo = &Nodes[MASTER_NODE];
+        if (ThreadInfo->AffinityLayout != AFFINITY_NONE) {
+            for (Node = 0; Node < CommSize; Node++) {
+                printf ("# affinity node %d : %s\n", Node, Bindings[Node]);
+            }
+            fflush (stdout);
+        }
+        for (k = 0; k < ThreadInfo->NoOfIntegrands; k++) {
+            if (ThreadInfo->RefineCachePath != NULL && ThreadInfo->ExtrapolationError[k] >= 0) {
+                std::cout<<ThreadInfo->IntegralOutput[k]<<" "<<ThreadInfo->Extrapolated[k]
+                    <<" "<<ThreadInfo->ExtrapolationError[k]<<std::endl;
+            }else {
+                std::cout<<ThreadInfo->IntegralOutput[k]<<std::endl;
+            }
+        }
+        std::cerr<<ThreadInfo->ElapsedTime<<std::endl;
+
+        if (ThreadInfo->NoOfWarmups + ThreadInfo->NoOfTrials > 1) {
+            int Len = ThreadInfo->Timer.NoOfTrials * (NO_OF_PHASES + 1);
+            double * AllTrials = new double [CommSize * Len];
+            for (Node = 0; Node < CommSize; Node++) {
+                memcpy (AllTrials + Node * Len, Nodes[Node].Timer.Trials, Len * sizeof(AllTrials[0]));
+            }
+            PhaseTimerPrint (ThreadInfo->Timer.NoOfTrials, CommSize, AllTrials, stdout);
+            delete[] AllTrials;
+        }
     }
 
+    for (Node = 0; Node < CommSize; Node++) {
+        TransportFree (&Nodes[Node].Transport);
+    }
+    delete[] Nodes;
+    delete[] Bindings;
+    TransportSharedFree (Shared);
+}
 
-    /* based on the input argument, select suitable function to integrate */
-    switch (FunctionID)
-    {
-        case 1:ThreadInfo.FuncToIntegrate = f1;
-               break;
-        case 2:ThreadInfo.FuncToIntegrate = f2;
-               break;
-        case 3:ThreadInfo.FuncToIntegrate = f3;
-               break;
-        case 4:ThreadInfo.FuncToIntegrate = f4;
-               break;
+/*==============================================================================
+ *  HybridCalibrate
+ *=============================================================================*/
 
-        default: 
-               DLOG(C_ERROR, "Invalid function input for integration\n");
-               goto EXIT;
+/*
+ * every slave times the same probe chunk. with speeds s_i, the slowest slave
+ * finishes its static block (F * N / (P - 1)) / s_min after the start, while the
+ * remainder keeps the others busy for about ((1 - F) * N / (P - 1)) / s_mean on
+ * top of their own blocks. the remainder absorbs the difference as long as
+ * F <= s_min / s_mean. variations of the cost over the range are not measured.
+ */
+static void HybridCalibrate (void * inArg)
+{
+    RefThreadData ThreadInfo = (RefThreadData)inArg;
+    int Node;
+    int CommSize = ThreadInfo->Transport.Size;
+    int ProcRank = ThreadInfo->Transport.Rank;
+    double Probe[MAX_INTEGRANDS];
+    double Speed = 0, MinSpeed = 0, MeanSpeed = 0;
+    double * Speeds = NULL;
+
+    if (ProcRank != MASTER_NODE) {
+        std::chrono::steady_clock::time_point ProbeStart = std::chrono::steady_clock::now();
+        ComputeChunk (ThreadInfo, 0, ThreadInfo->Granularity, Probe);
+        Speed = 1 / std::max (1e-9, std::chrono::duration<double>(std::chrono::steady_clock::now() - ProbeStart).count());
     }
 
+    if (ProcRank == MASTER_NODE) {
+        Speeds = new double [CommSize];
+    }
+    TransportGather (&ThreadInfo->Transport, &Speed, Speeds, 1, MASTER_NODE);
 
-    if (ProcRank == MASTER_NODE){
-        MasterWork(&ThreadInfo);
-    }else{
-        SlaveWork(&ThreadInfo);
+    if (ProcRank == MASTER_NODE) {
+        MinSpeed = Speeds[1];
+        for (Node = 1; Node < CommSize; Node++) {
+            MinSpeed = std::min (MinSpeed, Speeds[Node]);
+            MeanSpeed += Speeds[Node] / (CommSize - 1);
+        }
+        ThreadInfo->StaticFraction = std::min (HYBRID_MAX_FRACTION, MinSpeed / MeanSpeed);
+        DLOG (C_VERBOSE, "Node[master] slowest slave at %.3g of the mean speed, static fraction %.3g\n",
+                MinSpeed / MeanSpeed, ThreadInfo->StaticFraction);
+        delete[] Speeds;
     }
+    TransportBcast (&ThreadInfo->Transport, &ThreadInfo->StaticFraction, sizeof(ThreadInfo->StaticFraction), MASTER_NODE);
+}
 
+/*==============================================================================
+ *  SplitRequest
+ *=============================================================================*/
 
-EXIT:
-    MPI_Finalize();
+static int SplitRequest (char * Request, char * outArgv[])
+{
+    int Argc = 0;
 
-    return 0;
+    for (char * Token = strtok (Request, " \t"); Token != NULL && Argc < DAEMON_MAX_ARGS;
+            Token = strtok (NULL, " \t")) {
+        outArgv[Argc++] = Token;
+    }
+    return Argc;
+}
 
+/*==============================================================================
+ *  WriteJobResult
+ *=============================================================================*/
+
+/* "<result> [<result> ...] <time>", with --refine each result is followed by the extrapolation */
+static void WriteJobResult (FILE * Out, void * inArg)
+{
+    RefThreadData ThreadInfo = (RefThreadData)inArg;
+    int k;
+
+    for (k = 0; k < ThreadInfo->NoOfIntegrands; k++) {
+        fprintf (Out, "%.17g ", ThreadInfo->IntegralOutput[k]);
+        if (ThreadInfo->RefineCachePath != NULL && ThreadInfo->ExtrapolationError[k] >= 0) {
+            fprintf (Out, "%.17g %.3g ", ThreadInfo->Extrapolated[k], ThreadInfo->ExtrapolationError[k]);
+        }
+    }
+    fprintf (Out, "%.9f\n", ThreadInfo->ElapsedTime);
 }
 
 /* 
  * 1. assign (use MPI_Isend) 3 chunks of data to all the slaves in round robin order
- * 2. receive (use MPI_Recv) a message from slave requesting work & returing the integration result
+ * 2. receive (use MPI_Recv) a message from slave requesting work, it carries the integration
+ *    result of the chunk only in the backup mode
  * 3. store the result & check if work is available
  * 4. if work is available send (use MPI_Isend) the work struct to slave
  * 5. if work is not available signal (use MPI_Isend) slave to abort
  * 6. go to step 2
  * 7. If the message from the slave is SLAVE_TO_MASTER_EXITING, then master records that the slave
  *    has quit.
- * 8. When all the slaves have quit the master (is no longer a master :P) terminates! 
+ * 8. When all the slaves have quit the master (is no longer a master :P) combines the sums
+ *    accumulated by the slaves (use MPI_Reduce) & terminates!
  *
  */
 
+/*==============================================================================
+ *  SendChunk
+ *=============================================================================*/
+
+/* a chunk travels as 2 longs, a spawned worker is reached over its own communicator */
+static void SendChunk (RefThreadData ThreadInfo, RefElasticSt Elastic, int Node, int Tag, IndexSt * Index,
+        TransportRequest * outReq)
+{
+    MPI_Comm DestComm;
+    int Dest;
+
+    if (Elastic->MaxWorkers > 0 && Node >= Elastic->CommSize) {
+        DestComm = ElasticTarget (Elastic, ThreadInfo->Comm, Node, &Dest);
+        MPI_Isend (Index, 2, MPI_LONG, Dest, Tag, DestComm, outReq);
+    }else {
+        TransportIsend (&ThreadInfo->Transport, Node, Tag, Index, 2, TRANSPORT_LONG, outReq);
+    }
+}
+
 /*==============================================================================
  *  MasterWork
  *=============================================================================*/
@@ -204,66 +1505,68 @@ EXIT:
 static void MasterWork (void * inArg){
 
     RefThreadData ThreadInfo = (RefThreadData)inArg;
+    PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_SETUP);
 
-    int CommSize;
-    int ProcRank, Node;
-    MPI_Comm_size(MPI_COMM_WORLD, &CommSize);
-    MPI_Comm_rank(MPI_COMM_WORLD, &ProcRank);
+    int Node, Tag;
+    int CommSize = ThreadInfo->Transport.Size;
     MPI_Status Status[2];
-    MPI_Request SendReq[2];
+    TransportRequest SendReq[2];
 
     int QuitCounter = 0;
+    /* no of chunks handed out & returned, used by the work stealing mode to detect the end */
+    long Dispatched = 0, Completed = 0;
+    MPI_Request BarrierReq;
+    /* chunks outstanding at every slave, used by the backup mode */
+    SpecSt Spec = {0};
+    long ChunkStart;
+    int SpecResult = SPEC_FIRST, Other;
+    /* progress published by a separate thread */
+    MetricsSt Metrics;
+    /* decisions of this trial, written out with --record */
+    DecisionLogSt Record;
+    /* workers spawned during this trial */
+    ElasticSt Elastic = {0};
 
     /*ideally index2D should have been dynamically allocated */
     IndexSt index2D[MAX_PROCESSORS][MAX_CHUNK] = {0};
 
-    MPI_Datatype StructOfIndex;
-
-    /* create a single struct */
-    {
-        int NoOfBlocks = 2;               /* number of Blocks in the struct */
-        int Blocks[2] = {1, 1};   /* set up 2 Blocks */
-        MPI_Datatype Types[2] = {    /* index internal Types */
-            MPI_LONG,
-            MPI_LONG,
-        };
-        MPI_Aint Disp[2] = {          /* internal displacements */
-            offsetof(IndexSt, StartIndex),
-            offsetof(IndexSt, StopIndex),
-        };
-
-        MPI_Type_create_struct(NoOfBlocks, Blocks, Disp, Types, &StructOfIndex);
-        MPI_Type_commit(&StructOfIndex);
-    }
-
-    /* End of struct creation */
-
+    int k, NoOfIntegrands = ThreadInfo->NoOfIntegrands;
     double * IntegralOutput;
     double * NodeIntegralOutput;
-    IntegralOutput = new double [1];
-    NodeIntegralOutput = new double [1];
-    memset (IntegralOutput, 0, sizeof(IntegralOutput[0]));
-    memset (NodeIntegralOutput, 0, sizeof(NodeIntegralOutput[0]));
+    IntegralOutput = new double [NoOfIntegrands];
+    NodeIntegralOutput = new double [NoOfIntegrands];
+    memset (IntegralOutput, 0, NoOfIntegrands * sizeof(IntegralOutput[0]));
+    memset (NodeIntegralOutput, 0, NoOfIntegrands * sizeof(NodeIntegralOutput[0]));
 
     int ChunkIndex[MAX_PROCESSORS];
     memset (ChunkIndex,0,MAX_PROCESSORS * sizeof (int));
     int CurChunk;
 
+    if (ThreadInfo->SpeculativeBackup) {
+        SpecInit (&Spec, CommSize, ThreadInfo->PrefetchDepth);
+    }
+
     /* measure time taken for integration */
-    std::chrono::time_point<std::chrono::system_clock> StartTime;
-    std::chrono::time_point<std::chrono::system_clock>  EndTime;
+    std::chrono::time_point<std::chrono::steady_clock> StartTime;
+    std::chrono::time_point<std::chrono::steady_clock>  EndTime;
     std::chrono::duration<double> ElapsedTime;
-    StartTime = std::chrono::system_clock::now();
+    StartTime = std::chrono::steady_clock::now();
+    MetricsStart (&Metrics, &ThreadInfo->Metrics, CommSize + ThreadInfo->Elastic.MaxWorkers,
+            ThreadInfo->PrefetchDepth, ThreadInfo->NoOfPoints - ThreadInfo->StaticPoints);
+    if (ThreadInfo->RecordPath != NULL) {
+        DecisionLogInit (&Record, CommSize, ThreadInfo->NoOfPoints, ThreadInfo->StaticPoints);
+    }
+    if (ThreadInfo->ReplayPath != NULL) {
+        DecisionLogRewind (&ThreadInfo->Replay);
+    }
 
-    /* Assign 3 chunks of data to all the slave nodes in round robin order */
-    for (int i=0; i<MAX_CHUNK; i++) {
-        for (int Node=1; Node<CommSize; Node++) {
+    PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_DISTRIBUTION);
 
-            if (!IsLoopDone(ThreadInfo)) {
+    /* Assign PrefetchDepth (3) chunks of data to all the slave nodes in round robin order */
+    for (int i=0; i<ThreadInfo->PrefetchDepth; i++) {
+        for (int Node=1; Node<CommSize; Node++) {
 
-                GetNextLoop (ThreadInfo);
-                index2D[Node][i].StartIndex = ThreadInfo->StartIndex;
-                index2D[Node][i].StopIndex = ThreadInfo->StopIndex;
+            if (NextChunk (ThreadInfo, Node, &index2D[Node][i])) {
 
                 DLOG (C_VERBOSE, "Node[master] StartIndex = %d StopIndex = %d\n",
                         index2D[Node][i].StartIndex, index2D[Node][i].StopIndex);
@@ -271,62 +1574,216 @@ static void MasterWork (void * inArg){
                 DLOG (C_VERBOSE, "Node[master] Work Is Available. sending work to node :%d\n", Node);
 
                 /*ideally req will be in a array. need not be , as we are not checking the status */
-                MPI_Isend(&index2D[Node][i], 1, StructOfIndex, Node, MASTER_TO_SLAVE_WORK_AVAILABLE, MPI_COMM_WORLD, &SendReq[0]);
-
-
+                SendChunk (ThreadInfo, &Elastic, Node, MASTER_TO_SLAVE_WORK_AVAILABLE, &index2D[Node][i], &SendReq[0]);
+                Dispatched++;
+                MetricsDispatched (&Metrics, Node, index2D[Node][i].StopIndex - index2D[Node][i].StartIndex);
+                if (ThreadInfo->SpeculativeBackup) {
+                    SpecDispatched (&Spec, Node, index2D[Node][i].StartIndex);
+                }
+                if (ThreadInfo->RecordPath != NULL) {
+                    DecisionLogDispatched (&Record, Node, index2D[Node][i].StartIndex, index2D[Node][i].StopIndex, 0);
+                }
+
+            }else if (!ThreadInfo->WorkStealing) {
+
+                /* a slave expects PrefetchDepth replies, work or quit, before any result */
+                SendChunk (ThreadInfo, &Elastic, Node, MASTER_TO_SLAVE_QUIT, &index2D[Node][i], &SendReq[0]);
             }
         }
     }
 
+    if (ThreadInfo->WorkStealing && IsLoopDone(ThreadInfo)) {
+        NotifySlaves (ThreadInfo->Comm, MASTER_TO_SLAVE_RANGE_DONE);
+    }
+
+    if (ThreadInfo->Elastic.MaxWorkers > 0) {
+        ElasticInit (&Elastic, &ThreadInfo->Elastic, ThreadInfo->Comm, NoOfIntegrands);
+    }
 
     while (1) {
 
-        MPI_Recv (NodeIntegralOutput, 1, MPI_DOUBLE, MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &Status[0]);
+        PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_REDUCTION);
+        MetricsIdleBegin (&Metrics);
+        if (Elastic.MaxWorkers > 0) {
+            ElasticRecv (&Elastic, ThreadInfo->Comm, SLAVE_TO_MASTER_EXITING, &Node, &Status[0]);
+            Tag = Status[0].MPI_TAG;
+        }else {
+            TransportRecv (&ThreadInfo->Transport, TRANSPORT_ANY, TRANSPORT_ANY, NodeIntegralOutput, NoOfIntegrands,
+                    TRANSPORT_DOUBLE, &Node, &Tag);
+        }
+        MetricsIdleEnd (&Metrics);
 
-        if (Status[0].MPI_TAG == SLAVE_TO_MASTER_EXITING ){
+        if (Tag == SLAVE_TO_MASTER_EXITING ){
             QuitCounter++;
+            if (Node >= CommSize) {
+                /* a worker sends its local sum on its own communicator as soon as it exits */
+                ElasticRelease (&Elastic, Node, IntegralOutput, NoOfIntegrands);
+                DLOG (C_VERBOSE, "Node[master] worker %d released\n", Node);
+            }
 
-            if (QuitCounter == CommSize - 1){
+            if (QuitCounter == CommSize - 1 + Elastic.NoOfWorkers){
                 DLOG (C_VERBOSE, "Quit message received from all the slaves. master exiting\n");
                 break;
             }
+            /* the slave has exited, it does not need any more quit messages */
+            continue;
+        }
+
+        Completed++;
+        if (ThreadInfo->RecordPath != NULL) {
+            DecisionLogCompleted (&Record, Node);
         }
 
-        IntegralOutput[0] = IntegralOutput[0] + NodeIntegralOutput[0];
+        if (ThreadInfo->SpeculativeBackup) {
+            /* only the first copy of a chunk counts, the others are cancelled */
+            SpecResult = SpecCompleted (&Spec, Node, &ChunkStart);
+            if (SpecResult == SPEC_FIRST) {
+                for (Other = 1; Other < CommSize; Other++) {
+                    if (SpecHasCopy (&Spec, Other, ChunkStart)) {
+                        DLOG (C_VERBOSE, "Node[master] cancelling chunk %ld at node %d\n", ChunkStart, Other);
+                        TransportSend (&ThreadInfo->Transport, Other, MASTER_TO_SLAVE_CANCEL, &ChunkStart, 1, TRANSPORT_LONG);
+                        Spec.NoOfCancels++;
+                    }
+                }
+            }
+        }
+        if (ThreadInfo->WorkStealing) {
+            /* a stolen chunk is reported by the thief, along with its size */
+            MetricsReported (&Metrics, Node, (long) NodeIntegralOutput[0]);
+        }else {
+            /* a copy whose result is dropped only counts as a chunk back */
+            MetricsCompleted (&Metrics, Node, SpecResult != SPEC_DUPLICATE);
+        }
+        /* outside the backup mode the results stay at the slaves until the final reduce */
+        if (ThreadInfo->SpeculativeBackup && SpecResult == SPEC_FIRST) {
+            for (k = 0; k < NoOfIntegrands; k++) {
+                IntegralOutput[k] = IntegralOutput[k] + NodeIntegralOutput[k];
+            }
+        }
         DLOG (C_VERBOSE, "Node[master] IntegralOutput = %f, NodeIntegralOutput = %f\n", IntegralOutput[0], NodeIntegralOutput[0]);
 
-        Node = Status[0].MPI_SOURCE;
         CurChunk = GetFreeChunkIndex (Node, ChunkIndex);
-        index2D[Node][CurChunk].StartIndex = ThreadInfo->StartIndex;
-        index2D[Node][CurChunk].StopIndex = ThreadInfo->StopIndex;
 
-        if (!IsLoopDone(ThreadInfo)) {
+        PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_DISTRIBUTION);
+        if (!ElasticRetiring (&Elastic, Node) && NextChunk (ThreadInfo, Node, &index2D[Node][CurChunk])) {
 
             DLOG (C_VERBOSE, "Node[master] Work Is Available. sending work to node :%d\n", Node);
 
-            GetNextLoop (ThreadInfo);
-
-
             DLOG (C_VERBOSE, "Node[master] StartIndex = %d StopIndex = %d\n",
                     index2D[Node][CurChunk].StartIndex, index2D[Node][CurChunk].StopIndex);
 
-            MPI_Isend(&index2D[Node][CurChunk], 1, StructOfIndex , Node, MASTER_TO_SLAVE_WORK_AVAILABLE, MPI_COMM_WORLD, &SendReq[0]);
+            SendChunk (ThreadInfo, &Elastic, Node, MASTER_TO_SLAVE_WORK_AVAILABLE, &index2D[Node][CurChunk], &SendReq[0]);
+            Dispatched++;
+            MetricsDispatched (&Metrics, Node, index2D[Node][CurChunk].StopIndex - index2D[Node][CurChunk].StartIndex);
+            if (ThreadInfo->SpeculativeBackup) {
+                SpecDispatched (&Spec, Node, index2D[Node][CurChunk].StartIndex);
+            }
+            if (ThreadInfo->RecordPath != NULL) {
+                DecisionLogDispatched (&Record, Node, index2D[Node][CurChunk].StartIndex,
+                        index2D[Node][CurChunk].StopIndex, 0);
+            }
+
+            if (ThreadInfo->WorkStealing && IsLoopDone(ThreadInfo)) {
+                /* from now on the idle slaves steal from their peers */
+                NotifySlaves (ThreadInfo->Comm, MASTER_TO_SLAVE_RANGE_DONE);
+            }
+
+        }else if (ThreadInfo->SpeculativeBackup && SpecPickBackup (&Spec, Node, &ChunkStart)) {
+
+            /* no fresh work left, the slave computes a copy of a straggling chunk */
+            DLOG (C_VERBOSE, "Node[master] reissuing chunk %ld to node :%d\n", ChunkStart, Node);
+            index2D[Node][CurChunk].StartIndex = ChunkStart;
+            index2D[Node][CurChunk].StopIndex = std::min (ChunkStart + ThreadInfo->Granularity, ThreadInfo->NoOfPoints);
+            SendChunk (ThreadInfo, &Elastic, Node, MASTER_TO_SLAVE_WORK_AVAILABLE, &index2D[Node][CurChunk], &SendReq[0]);
+            SpecDispatched (&Spec, Node, ChunkStart);
+            MetricsDispatched (&Metrics, Node, index2D[Node][CurChunk].StopIndex - index2D[Node][CurChunk].StartIndex);
+            if (ThreadInfo->RecordPath != NULL) {
+                DecisionLogDispatched (&Record, Node, index2D[Node][CurChunk].StartIndex,
+                        index2D[Node][CurChunk].StopIndex, DECISION_BACKUP_COPY);
+            }
+
+        }else if (ThreadInfo->WorkStealing) {
+
+            /* a stolen chunk is returned by the thief, so only the total count is meaningful */
+            if (Completed == Dispatched) {
+                DLOG (C_VERBOSE, "Node[master] all the chunks are back. sending quit to all the nodes\n");
+                PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_SHUTDOWN);
+                NotifySlaves (ThreadInfo->Comm, MASTER_TO_SLAVE_QUIT);
+                /* the slaves leave the barrier once no steal request is left unanswered */
+                MPI_Ibarrier (ThreadInfo->Comm, &BarrierReq);
+                MPI_Wait (&BarrierReq, MPI_STATUS_IGNORE);
+                break;
+            }
 
         }else {
 
             DLOG (C_VERBOSE, "Node[master] Work Is not Available. sending quit to node :%d\n", Node);
-            MPI_Isend(&index2D[Node][CurChunk], 1, StructOfIndex , Node, MASTER_TO_SLAVE_QUIT, MPI_COMM_WORLD, &SendReq[0]);
+            PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_SHUTDOWN);
+            SendChunk (ThreadInfo, &Elastic, Node, MASTER_TO_SLAVE_QUIT, &index2D[Node][CurChunk], &SendReq[0]);
+        }
+
+        /* grow while the points left would take long at the current rate or on request, shrink on request */
+        if (Elastic.MaxWorkers > 0) {
+            ElapsedTime = std::chrono::steady_clock::now() - StartTime;
+            if (ElasticWantWorker (&Elastic, ElapsedTime.count(), PointsLeft (ThreadInfo),
+                        Completed * ThreadInfo->Granularity)) {
+                PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_SETUP);
+                if (ElasticSpawn (&Elastic, ThreadInfo->Comm, ThreadInfo->JobArgv, ThreadInfo->PrefetchDepth,
+                            ElapsedTime.count(), &Node) == C_SUCCESS) {
+                    DLOG (C_VERBOSE, "Node[master] worker %d joined\n", Node);
+                    PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_DISTRIBUTION);
+                    /* the worker is filled like the slaves at the start */
+                    for (int i = 0; i < ThreadInfo->PrefetchDepth; i++) {
+                        if (NextChunk (ThreadInfo, Node, &index2D[Node][i])) {
+                            SendChunk (ThreadInfo, &Elastic, Node, MASTER_TO_SLAVE_WORK_AVAILABLE, &index2D[Node][i], &SendReq[0]);
+                            Dispatched++;
+                            MetricsDispatched (&Metrics, Node, index2D[Node][i].StopIndex - index2D[Node][i].StartIndex);
+                        }else {
+                            SendChunk (ThreadInfo, &Elastic, Node, MASTER_TO_SLAVE_QUIT, &index2D[Node][i], &SendReq[0]);
+                        }
+                    }
+                }else {
+                    DLOG(C_ERROR, "Unable to spawn a worker\n");
+                }
+            }
+            if (ElasticWantRetire (&Elastic, &Node)) {
+                /* its next results are answered with quits, the chunks it holds are completed */
+                DLOG (C_VERBOSE, "Node[master] retiring worker %d\n", Node);
+            }
         }
     }
 
+    /* combine the sums accumulated by the slaves */
+    PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_REDUCTION);
+    TransportReduce (&ThreadInfo->Transport, IntegralOutput, IntegralOutput, NoOfIntegrands, TRANSPORT_SUM, MASTER_NODE);
+
     /* compute the time taken to compute the sum and display the same */
-    EndTime = std::chrono::system_clock::now();
+    EndTime = std::chrono::steady_clock::now();
     ElapsedTime = EndTime - StartTime;
 
-    std::cout<<IntegralOutput[0]<<std::endl;
-    std::cerr<<ElapsedTime.count()<<std::endl;
+    PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_SHUTDOWN);
+    MetricsStop (&Metrics);
+    memcpy (ThreadInfo->IntegralOutput, IntegralOutput, NoOfIntegrands * sizeof(IntegralOutput[0]));
+    ThreadInfo->ElapsedTime = ElapsedTime.count();
 
-    MPI_Type_free(&StructOfIndex);
+    if (Elastic.MaxWorkers > 0) {
+        DLOG (C_VERBOSE, "Node[master] %d workers spawned\n", Elastic.NoOfWorkers);
+        ElasticFree (&Elastic);
+    }
+
+    /* every trial overwrites the log, the last one is kept */
+    if (ThreadInfo->RecordPath != NULL) {
+        if (DecisionLogWrite (&Record, ThreadInfo->RecordPath) != C_SUCCESS) {
+            DLOG(C_ERROR, "Unable to write %s\n", ThreadInfo->RecordPath);
+        }
+        DecisionLogFree (&Record);
+    }
+
+    if (ThreadInfo->SpeculativeBackup) {
+        DLOG (C_VERBOSE, "Node[master] %ld chunks reissued, %ld copies cancelled\n",
+                Spec.NoOfBackups, Spec.NoOfCancels);
+        SpecFree (&Spec);
+    }
 
     delete[] NodeIntegralOutput;
     delete[] IntegralOutput;
@@ -334,7 +1791,9 @@ static void MasterWork (void * inArg){
 }
 
 /*
- * 0.1 send (use MPI_Isend) integration to the master, initially 0.
+ * 0. compute the static block of the hybrid scheduler, if any.
+ * 0.1 send (use MPI_Isend) a work request to the master, with the integration of the chunk
+ *    only in the backup mode. otherwise add it to the local sum.
  * 1. receive (use MPI_Recv) a data from master.
  * 2. compute the integration.
  * 3. check if the last sent data to the master was received successfully 
@@ -343,7 +1802,7 @@ static void MasterWork (void * inArg){
  * 5. If the message from the master is to quit, then the slave increments its
  *    quit counter 
  * 6. If the quit counter is 3 then the slave terminates by sending
- *    a SLAVE_TO_MASTER_EXITING message to master
+ *    a SLAVE_TO_MASTER_EXITING message to master & sends its local sum with MPI_Reduce
  */
 
 /*==============================================================================
@@ -353,97 +1812,415 @@ static void MasterWork (void * inArg){
 static void SlaveWork (void * inArg){
 
     RefThreadData ThreadInfo = (RefThreadData)inArg;
+    PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_SETUP);
 
-    int CommSize;
-    int ProcRank;
-    MPI_Comm_size(MPI_COMM_WORLD, &CommSize);
-    MPI_Comm_rank(MPI_COMM_WORLD, &ProcRank);
-    MPI_Status status;
-    MPI_Request SendReq;
+    int Tag;
+    int CommSize = ThreadInfo->Transport.Size;
+    int ProcRank = ThreadInfo->Transport.Rank;
+    TransportRequest SendReq = MPI_REQUEST_NULL;
 
     IndexSt Index;
-    long i, StartIndex, StopIndex;
+    long StartIndex, StopIndex, BlockSize;
+    int NoOfIntegrands = ThreadInfo->NoOfIntegrands;
 
     double * NodeIntegralOutput;
-    double  NodeIntegralTemp = 0;
-    NodeIntegralOutput = new double [1];
-    memset (NodeIntegralOutput, 0, sizeof(NodeIntegralOutput[0]));
+    double  NodeIntegralTemp[MAX_INTEGRANDS];
+    /* sum over all the chunks computed by this slave, combined with MPI_Reduce at the end */
+    double  LocalIntegral[MAX_INTEGRANDS];
+    NodeIntegralOutput = new double [NoOfIntegrands];
+    memset (NodeIntegralOutput, 0, NoOfIntegrands * sizeof(NodeIntegralOutput[0]));
+    memset (LocalIntegral, 0, sizeof(LocalIntegral));
+    /* a result is only shipped with the work request in the backup mode, where the master picks the first copy */
+    int k, ResultCount = ThreadInfo->SpeculativeBackup ? NoOfIntegrands : 0;
 
-    double y, x, FuncOutput;
     int QuitCounter = 0;
 
-    MPI_Datatype StructOfIndex;
-    /* create a single struct */
-    {
-        int NoOfBlocks = 2;               /* number of Blocks in the struct */
-        int Blocks[2] = {1, 1};   /* set up 2 Blocks */
-        MPI_Datatype Types[2] = {    /* index internal Types */
-            MPI_LONG,
-            MPI_LONG,
-        };
-        MPI_Aint Disp[2] = {          /* internal displacements */
-            offsetof(IndexSt, StartIndex),
-            offsetof(IndexSt, StopIndex),
-        };
-
-        MPI_Type_create_struct(NoOfBlocks, Blocks, Disp, Types, &StructOfIndex);
-        MPI_Type_commit(&StructOfIndex);
+    if (ThreadInfo->StaticPoints > 0) {
+        /* the static block of this slave needs no message, the chunks of the master queue up meanwhile */
+        BlockSize = (ThreadInfo->StaticPoints + CommSize - 2) / (CommSize - 1);
+        StartIndex = std::min ((ProcRank - 1) * BlockSize, ThreadInfo->StaticPoints);
+        StopIndex = std::min (StartIndex + BlockSize, ThreadInfo->StaticPoints);
+
+        PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_COMPUTE);
+        ComputeChunk (ThreadInfo, StartIndex, StopIndex, LocalIntegral);
     }
 
     while (1){
 
-        MPI_Recv (&Index, 1, StructOfIndex, MASTER_NODE, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+        PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_DISTRIBUTION);
+        if (ThreadInfo->SpeculativeBackup) {
+            /* a cancel may come ahead of the next chunk */
+            if (TransportProbe (&ThreadInfo->Transport, MASTER_NODE, TRANSPORT_ANY) == MASTER_TO_SLAVE_CANCEL) {
+                PollCancel (ThreadInfo, -1);
+                continue;
+            }
+        }
+        TransportRecv (&ThreadInfo->Transport, MASTER_NODE, TRANSPORT_ANY, &Index, 2, TRANSPORT_LONG, NULL, &Tag);
 
-        if (status.MPI_TAG == MASTER_TO_SLAVE_WORK_AVAILABLE) {
+        if (Tag == MASTER_TO_SLAVE_WORK_AVAILABLE) {
 
             DLOG (C_VERBOSE, "Node[%d] Doing Work. Computing integration\n", ProcRank);
             StartIndex = Index.StartIndex;
             StopIndex = Index.StopIndex;
             DLOG (C_VERBOSE, "Node[%d] StartIndex = %d StopIndex = %d\n", ProcRank, StartIndex, StopIndex);
 
-            /*  y = (a - b)/n */
-            y = (ThreadInfo->UpperBound - ThreadInfo->LowerBound)/ThreadInfo->NoOfPoints;
-            NodeIntegralTemp = 0;
-            for (i = StartIndex; i< StopIndex; i++) {
-                x = (ThreadInfo->LowerBound + ((i + 0.5)* y ));
-                FuncOutput = (double) ThreadInfo->FuncToIntegrate (x,ThreadInfo->Intensity );
-                FuncOutput = FuncOutput * y ;
-                NodeIntegralTemp += (double) FuncOutput;
-            }
-            /* Ideally NodeIntegralOutput has to be an array, as we are using MPI_Isend,
-             * and there should be a MPI_Wait() but since the NoOfPoints is large we can assume that master receives 
-             * the value sent by slave before the slave finishes computing the next iteration.
-             */
-
-            NodeIntegralOutput[0] = NodeIntegralTemp;
-            DLOG (C_VERBOSE, "Node[%d] Sending integration %f y = %f\n", ProcRank, NodeIntegralOutput[0], y);
-            MPI_Isend (NodeIntegralOutput, 1, MPI_DOUBLE, MASTER_NODE,
-                    SLAVE_TO_MASTER_REQ_WORK, MPI_COMM_WORLD, &SendReq);
+            PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_COMPUTE);
+            if (!ComputeChunk (ThreadInfo, StartIndex, StopIndex, NodeIntegralTemp)) {
+                /* the result is still sent, the master ignores it */
+                DLOG (C_VERBOSE, "Node[%d] chunk %ld cancelled\n", ProcRank, StartIndex);
+            }
+
+            PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_REDUCTION);
+            if (!ThreadInfo->SpeculativeBackup) {
+                for (k = 0; k < NoOfIntegrands; k++) {
+                    LocalIntegral[k] += NodeIntegralTemp[k];
+                }
+            }
+            /* the previous result must have left the buffer before it is reused */
+            TransportWait (&ThreadInfo->Transport, &SendReq);
+            memcpy (NodeIntegralOutput, NodeIntegralTemp, NoOfIntegrands * sizeof(NodeIntegralOutput[0]));
+            DLOG (C_VERBOSE, "Node[%d] Sending integration %f\n", ProcRank, NodeIntegralOutput[0]);
+            TransportIsend (&ThreadInfo->Transport, MASTER_NODE, SLAVE_TO_MASTER_REQ_WORK, NodeIntegralOutput,
+                    ResultCount, TRANSPORT_DOUBLE, &SendReq);
 
 
 
 
 
-        }else if (status.MPI_TAG == MASTER_TO_SLAVE_QUIT) {
+        }else if (Tag == MASTER_TO_SLAVE_QUIT) {
             QuitCounter++;
             DLOG (C_VERBOSE, "Node[%d] Quit message received from master. QuitCounter = %d\n", ProcRank,QuitCounter);
 
-            if (QuitCounter >= 3 ){
-                NodeIntegralOutput[0] = 0;
+            if (QuitCounter >= ThreadInfo->PrefetchDepth ){
+                PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_SHUTDOWN);
+                TransportWait (&ThreadInfo->Transport, &SendReq);
                 DLOG (C_VERBOSE, "Node[%d] Node exiting\n", ProcRank);
-                MPI_Isend (NodeIntegralOutput, 1, MPI_DOUBLE, MASTER_NODE,
-                        SLAVE_TO_MASTER_EXITING, MPI_COMM_WORLD, &SendReq);
+                TransportIsend (&ThreadInfo->Transport, MASTER_NODE, SLAVE_TO_MASTER_EXITING, NodeIntegralOutput,
+                        0, TRANSPORT_DOUBLE, &SendReq);
 
                 break;
             }
         }
     }
 
+    TransportWait (&ThreadInfo->Transport, &SendReq);
+    PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_REDUCTION);
+    TransportReduce (&ThreadInfo->Transport, LocalIntegral, NULL, NoOfIntegrands, TRANSPORT_SUM, MASTER_NODE);
+    PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_SHUTDOWN);
+
+    delete[] NodeIntegralOutput;
+}
+
+/*
+ * work stealing mode, the master is only involved in handing out the range :
+ * 1. queue every chunk received from the master (or from a peer) locally
+ * 2. between two chunks, answer the steal requests of the peers with the
+ *    most recently queued chunk, or with a deny if the queue is empty
+ * 3. compute the oldest queued chunk, add it to the local sum & report it to the master
+ * 4. once the master has handed out the whole range & the queue is empty,
+ *    send a steal request to a random peer & wait for its answer
+ * 5. on quit (all the chunks are back at the master), keep denying steal
+ *    requests until every node has entered the final barrier
+ * 6. send the local sum to the master with MPI_Reduce
+ */
+
+/*==============================================================================
+ *  SlaveStealWork
+ *=============================================================================*/
+
+static void SlaveStealWork (void * inArg){
+
+    RefThreadData ThreadInfo = (RefThreadData)inArg;
+    PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_SETUP);
+
+    int CommSize;
+    int ProcRank;
+    MPI_Comm_size(ThreadInfo->Comm, &CommSize);
+    MPI_Comm_rank(ThreadInfo->Comm, &ProcRank);
+    MPI_Status status;
+    MPI_Request SendReq = MPI_REQUEST_NULL;
+    MPI_Request BarrierReq = MPI_REQUEST_NULL;
+
+    /* chunks not started yet, the oldest one at QueueHead */
+    IndexSt Queue[STEAL_QUEUE_LEN];
+    int QueueHead = 0, QueueCount = 0;
+    IndexSt Index;
+    int Dummy = 0, Flag, Victim;
+    unsigned int Seed = (unsigned int) ProcRank;
+    bool RangeDone = false, Quitting = false, StealPending = false;
+    int NoOfStolen = 0;
+
+    int k, NoOfIntegrands = ThreadInfo->NoOfIntegrands;
+    double * NodeIntegralOutput;
+    double  NodeIntegralTemp[MAX_INTEGRANDS];
+    /* sum over all the chunks computed by this slave, stolen ones included */
+    double  LocalIntegral[MAX_INTEGRANDS];
+    NodeIntegralOutput = new double [NoOfIntegrands];
+    memset (LocalIntegral, 0, sizeof(LocalIntegral));
+
+    MPI_Datatype StructOfIndex;
+    CreateIndexType (&StructOfIndex);
+
+    PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_DISTRIBUTION);
+
+    while (1) {
+
+        MPI_Iprobe (MPI_ANY_SOURCE, MPI_ANY_TAG, ThreadInfo->Comm, &Flag, &status);
+
+        if (Flag) {
+            switch (status.MPI_TAG) {
+
+                case MASTER_TO_SLAVE_WORK_AVAILABLE:
+                case SLAVE_TO_SLAVE_STEAL_GRANT:
+                    MPI_Recv (&Index, 1, StructOfIndex, status.MPI_SOURCE, status.MPI_TAG, ThreadInfo->Comm, &status);
+                    Queue[(QueueHead + QueueCount) % STEAL_QUEUE_LEN] = Index;
+                    QueueCount++;
+                    if (status.MPI_TAG == SLAVE_TO_SLAVE_STEAL_GRANT) {
+                        DLOG (C_VERBOSE, "Node[%d] stole %ld..%ld from node %d\n", ProcRank,
+                                Index.StartIndex, Index.StopIndex, status.MPI_SOURCE);
+                        StealPending = false;
+                        NoOfStolen++;
+                    }
+                    break;
+
+                case SLAVE_TO_SLAVE_STEAL_REQ:
+                    MPI_Recv (&Dummy, 1, MPI_INT, status.MPI_SOURCE, status.MPI_TAG, ThreadInfo->Comm, &status);
+                    if (QueueCount > 0) {
+                        /* give away the chunk which would have been computed last */
+                        QueueCount--;
+                        Index = Queue[(QueueHead + QueueCount) % STEAL_QUEUE_LEN];
+                        MPI_Send (&Index, 1, StructOfIndex, status.MPI_SOURCE, SLAVE_TO_SLAVE_STEAL_GRANT, ThreadInfo->Comm);
+                    }else {
+                        MPI_Send (&Dummy, 1, MPI_INT, status.MPI_SOURCE, SLAVE_TO_SLAVE_STEAL_DENY, ThreadInfo->Comm);
+                    }
+                    break;
+
+                case SLAVE_TO_SLAVE_STEAL_DENY:
+                    MPI_Recv (&Dummy, 1, MPI_INT, status.MPI_SOURCE, status.MPI_TAG, ThreadInfo->Comm, &status);
+                    StealPending = false;
+                    break;
+
+                case MASTER_TO_SLAVE_RANGE_DONE:
+                    MPI_Recv (&Dummy, 1, MPI_INT, status.MPI_SOURCE, status.MPI_TAG, ThreadInfo->Comm, &status);
+                    RangeDone = true;
+                    break;
+
+                case MASTER_TO_SLAVE_QUIT:
+                    MPI_Recv (&Dummy, 1, MPI_INT, status.MPI_SOURCE, status.MPI_TAG, ThreadInfo->Comm, &status);
+                    DLOG (C_VERBOSE, "Node[%d] Quit message received from master, %d chunks stolen\n",
+                            ProcRank, NoOfStolen);
+                    PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_SHUTDOWN);
+                    Quitting = true;
+                    break;
+
+                default:
+                    DLOG (C_ERROR, "Node[%d] unexpected tag %d\n", ProcRank, status.MPI_TAG);
+                    break;
+            }
+            continue;
+        }
+
+        if (Quitting) {
+            /* a peer may still be waiting for the answer to a steal request */
+            if (!StealPending && BarrierReq == MPI_REQUEST_NULL) {
+                MPI_Ibarrier (ThreadInfo->Comm, &BarrierReq);
+            }
+            if (BarrierReq != MPI_REQUEST_NULL) {
+                MPI_Test (&BarrierReq, &Flag, MPI_STATUS_IGNORE);
+                if (Flag) {
+                    break;
+                }
+            }
+            continue;
+        }
+
+        if (QueueCount > 0) {
+
+            Index = Queue[QueueHead];
+            QueueHead = (QueueHead + 1) % STEAL_QUEUE_LEN;
+            QueueCount--;
+
+            PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_COMPUTE);
+            ComputeChunk (ThreadInfo, Index.StartIndex, Index.StopIndex, NodeIntegralTemp);
+
+            PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_REDUCTION);
+            for (k = 0; k < NoOfIntegrands; k++) {
+                LocalIntegral[k] += NodeIntegralTemp[k];
+            }
+            /* the master only counts the chunks coming back & their points */
+            MPI_Wait (&SendReq, MPI_STATUS_IGNORE);
+            NodeIntegralOutput[0] = (double) (Index.StopIndex - Index.StartIndex);
+            MPI_Isend (NodeIntegralOutput, 1, MPI_DOUBLE, MASTER_NODE,
+                    SLAVE_TO_MASTER_REQ_WORK, ThreadInfo->Comm, &SendReq);
+
+            PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_DISTRIBUTION);
+            continue;
+        }
+
+        if (RangeDone && !StealPending && CommSize > 2) {
+            /* any slave but this one */
+            Victim = 1 + (int) (rand_r (&Seed) % (unsigned int) (CommSize - 2));
+            if (Victim >= ProcRank) {
+                Victim++;
+            }
+            MPI_Send (&Dummy, 1, MPI_INT, Victim, SLAVE_TO_SLAVE_STEAL_REQ, ThreadInfo->Comm);
+            StealPending = true;
+        }
+    }
+
+    MPI_Wait (&SendReq, MPI_STATUS_IGNORE);
+    PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_REDUCTION);
+    MPI_Reduce (LocalIntegral, NULL, NoOfIntegrands, MPI_DOUBLE, MPI_SUM, MASTER_NODE, ThreadInfo->Comm);
+    PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_SHUTDOWN);
     MPI_Type_free(&StructOfIndex);
 
     delete[] NodeIntegralOutput;
 }
 
+/*==============================================================================
+ *  NotifySlaves
+ *=============================================================================*/
+
+static void NotifySlaves (MPI_Comm Comm, int Tag)
+{
+    int CommSize, Node, Dummy = 0;
+    MPI_Comm_size(Comm, &CommSize);
+
+    for (Node = 1; Node < CommSize; Node++) {
+        MPI_Send (&Dummy, 1, MPI_INT, Node, Tag, Comm);
+    }
+}
+
+/*==============================================================================
+ *  CreateIndexType
+ *=============================================================================*/
+
+static void CreateIndexType (MPI_Datatype * outType)
+{
+    /* create a single struct */
+    int NoOfBlocks = 2;               /* number of Blocks in the struct */
+    int Blocks[2] = {1, 1};   /* set up 2 Blocks */
+    MPI_Datatype Types[2] = {    /* index internal Types */
+        MPI_LONG,
+        MPI_LONG,
+    };
+    MPI_Aint Disp[2] = {          /* internal displacements */
+        offsetof(IndexSt, StartIndex),
+        offsetof(IndexSt, StopIndex),
+    };
+
+    MPI_Type_create_struct(NoOfBlocks, Blocks, Disp, Types, outType);
+    MPI_Type_commit(outType);
+}
+
+/*==============================================================================
+ *  ComputeChunk
+ *=============================================================================*/
+
+/* returns false if the chunk was cancelled by the master, the partial result is then meaningless */
+static bool ComputeChunk (void * inArg, long StartIndex, long StopIndex, double * outIntegral)
+{
+    RefThreadData ThreadInfo = (RefThreadData)inArg;
+    long i;
+    int k, NoOfIntegrands = ThreadInfo->NoOfIntegrands;
+    double y, x, FuncOutput;
+    /* position of the current point within a cell of the cached coarse grid */
+    long ReusePhase;
+    bool ReuseSkip;
+    /* samples of the chunk, NULL unless they are dumped */
+    double * Sample = SampleDumpBegin (&ThreadInfo->Dump, StartIndex);
+    std::chrono::steady_clock::time_point ChunkStart = std::chrono::steady_clock::now();
+
+    /*  y = (a - b)/n */
+    y = (ThreadInfo->UpperBound - ThreadInfo->LowerBound)/ThreadInfo->NoOfPoints;
+    memset (outIntegral, 0, NoOfIntegrands * sizeof(outIntegral[0]));
+    ReusePhase = (ThreadInfo->ReuseStride != 0) ? StartIndex % ThreadInfo->ReuseStride : 0;
+    for (i = StartIndex; i< StopIndex; i++) {
+        if (ThreadInfo->SpeculativeBackup && (i - StartIndex) % BACKUP_POLL_POINTS == 0 &&
+                PollCancel (ThreadInfo, StartIndex)) {
+            return false;
+        }
+        if (ThreadInfo->ReuseStride != 0) {
+            /* the centre point of every coarse cell is already in the cache */
+            ReuseSkip = (ReusePhase == ThreadInfo->ReuseStride / 2);
+            if (++ReusePhase == ThreadInfo->ReuseStride) {
+                ReusePhase = 0;
+            }
+            if (ReuseSkip) {
+                continue;
+            }
+        }
+        x = (ThreadInfo->LowerBound + ((i + 0.5)* y ));
+        if (Sample != NULL && ThreadInfo->Dump.WithX) {
+            *Sample++ = x;
+        }
+        for (k = 0; k < NoOfIntegrands; k++) {
+            FuncOutput = (double) ThreadInfo->Integrands[k].FuncToIntegrate (x, ThreadInfo->Integrands[k].Intensity);
+            if (Sample != NULL) {
+                *Sample++ = FuncOutput;
+            }
+            FuncOutput = FuncOutput * y ;
+            outIntegral[k] += (double) FuncOutput;
+        }
+        if (Sample != NULL) {
+            Sample = SampleDumpNext (&ThreadInfo->Dump, Sample);
+        }
+    }
+    SynthStretch (ChunkStart);
+    /* the last slice of the chunk, a cancelled chunk has dropped it above */
+    if (Sample != NULL) {
+        SampleDumpWrite (&ThreadInfo->Dump);
+    }
+    return true;
+}
+
+/*==============================================================================
+ *  PollCancel
+ *=============================================================================*/
+
+static bool PollCancel (void * inArg, long StartIndex)
+{
+    RefThreadData ThreadInfo = (RefThreadData)inArg;
+    long CancelIndex;
+    int Slot;
+
+    while (TransportIprobe (&ThreadInfo->Transport, MASTER_NODE, MASTER_TO_SLAVE_CANCEL)) {
+        TransportRecv (&ThreadInfo->Transport, MASTER_NODE, MASTER_TO_SLAVE_CANCEL, &CancelIndex, 1, TRANSPORT_LONG,
+                NULL, NULL);
+        ThreadInfo->CancelledChunks[ThreadInfo->CancelSlot] = CancelIndex;
+        ThreadInfo->CancelSlot = (ThreadInfo->CancelSlot + 1) % BACKUP_CANCEL_LEN;
+    }
+
+    for (Slot = 0; Slot < BACKUP_CANCEL_LEN; Slot++) {
+        if (ThreadInfo->CancelledChunks[Slot] == StartIndex) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*==============================================================================
+ *  NextChunk
+ *=============================================================================*/
+
+/* next chunk to be sent to Node, returns false if there is none left for it */
+static bool NextChunk (void * inArg, int Node, RefIndexSt outIndex)
+{
+    RefThreadData ThreadInfo = (RefThreadData)inArg;
+
+    if (ThreadInfo->ReplayPath != NULL) {
+        return DecisionLogNext (&ThreadInfo->Replay, Node, &outIndex->StartIndex, &outIndex->StopIndex);
+    }
+    if (IsLoopDone (ThreadInfo)) {
+        return false;
+    }
+    GetNextLoop (ThreadInfo);
+    outIndex->StartIndex = ThreadInfo->StartIndex;
+    outIndex->StopIndex = ThreadInfo->StopIndex;
+
+    return true;
+}
+
 /*==============================================================================
  *  IsLoopDone
  *=============================================================================*/
@@ -454,7 +2231,11 @@ bool IsLoopDone (void * inArg)
     RefThreadData ThreadInfo = (RefThreadData)inArg;
 
     DLOG (C_VERBOSE, "ThreadInfo->CompletedIndex = %d\n", ThreadInfo->CompletedIndex);
-    if (ThreadInfo->CompletedIndex == ThreadInfo->NoOfPoints){
+    if (ThreadInfo->DispatchOrder == DISPATCH_ORDER_LPT) {
+        /* the chunks handed out are not a prefix of the range */
+        C_Status = CostOrderDone (&ThreadInfo->Order);
+    }
+    else if (ThreadInfo->CompletedIndex == ThreadInfo->NoOfPoints){
         C_Status = true;
     }
     else{
@@ -475,7 +2256,13 @@ int GetNextLoop (void * inArg)
     int C_Status = C_SUCCESS; 
     RefThreadData ThreadInfo = (RefThreadData)inArg;
 
-    DLOG (C_VERBOSE, "Granularity = %d\n",ThreadInfo->Granularity);
+    DLOG (C_VERBOSE, "Granularity = %ld\n",ThreadInfo->Granularity);
+
+    if (ThreadInfo->DispatchOrder == DISPATCH_ORDER_LPT) {
+        CostOrderNext (&ThreadInfo->Order, &ThreadInfo->StartIndex, &ThreadInfo->StopIndex);
+        DLOG (C_VERBOSE, "ThreadInfo->StartIndex = %ld\n", ThreadInfo->StartIndex);
+        return C_Status;
+    }
 
     ThreadInfo->StartIndex = ThreadInfo->CompletedIndex;
     ThreadInfo->StopIndex = ThreadInfo->CompletedIndex + ThreadInfo->Granularity;
@@ -491,6 +2278,20 @@ int GetNextLoop (void * inArg)
     return C_Status;
 }
 
+/*==============================================================================
+ *  PointsLeft
+ *=============================================================================*/
+
+static long PointsLeft (void * inArg)
+{
+    RefThreadData ThreadInfo = (RefThreadData)inArg;
+
+    if (ThreadInfo->DispatchOrder == DISPATCH_ORDER_LPT) {
+        return ThreadInfo->Order.PointsLeft;
+    }
+    return ThreadInfo->NoOfPoints - ThreadInfo->CompletedIndex;
+}
+
 /*==============================================================================
  *  GetFreeChunkIndex
  *=============================================================================*/
@@ -499,11 +2300,92 @@ int GetFreeChunkIndex (int Node, int * ChunkIndex)
 {
     int IndexToBeReused;
     IndexToBeReused = ChunkIndex[Node];
-    /* the 2D Index[][] has only 3 columns */
-    if (ChunkIndex[Node] >= 2)
+    /* the 2D Index[][] has only MAX_CHUNK columns */
+    if (ChunkIndex[Node] >= MAX_CHUNK - 1)
         ChunkIndex[Node] = 0;
     else
         ChunkIndex[Node]++;
 
     return IndexToBeReused;
 }
+
+/*==============================================================================
+ *  RefineSetup
+ *=============================================================================*/
+
+static void RefineSetup (void * inArg)
+{
+    RefThreadData ThreadInfo = (RefThreadData)inArg;
+    long CoarsePoints, ReusePoints = 0;
+    int k;
+
+    /* the points of a cached coarse grid can be skipped only if the same grid is cached
+     * for all the integrands */
+    for (k = 0; k < ThreadInfo->NoOfIntegrands; k++) {
+        if (RefineCacheLookup (ThreadInfo->RefineCachePath, ThreadInfo->Integrands[k].FunctionID,
+                    ThreadInfo->Integrands[k].Intensity, ThreadInfo->LowerBound, ThreadInfo->UpperBound,
+                    ThreadInfo->NoOfPoints, ThreadInfo->NoOfPoints, &CoarsePoints,
+                    &ThreadInfo->ReuseRawSum[k]) != C_SUCCESS) {
+            ReusePoints = 0;
+            break;
+        }
+        if (k != 0 && CoarsePoints != ReusePoints) {
+            ReusePoints = 0;
+            break;
+        }
+        ReusePoints = CoarsePoints;
+    }
+
+    if (ReusePoints != 0) {
+        ThreadInfo->ReuseStride = ThreadInfo->NoOfPoints / ReusePoints;
+    }else {
+        ThreadInfo->ReuseStride = 0;
+        memset (ThreadInfo->ReuseRawSum, 0, sizeof(ThreadInfo->ReuseRawSum));
+    }
+
+    DLOG (C_VERBOSE, "Node[master] reusing %ld cached points, ReuseStride = %ld\n",
+            ReusePoints, ThreadInfo->ReuseStride);
+}
+
+/*==============================================================================
+ *  RefineFinish
+ *=============================================================================*/
+
+/*
+ * adds the cached sum to the result, caches the new grid & extrapolates from the
+ * largest nested coarse grid. ExtrapolationError is -1 if no such grid was cached.
+ */
+static void RefineFinish (void * inArg)
+{
+    RefThreadData ThreadInfo = (RefThreadData)inArg;
+    long CoarsePoints;
+    double y, RawSum, CoarseRawSum;
+    int k;
+
+    /*  y = (a - b)/n */
+    y = (ThreadInfo->UpperBound - ThreadInfo->LowerBound)/ThreadInfo->NoOfPoints;
+
+    for (k = 0; k < ThreadInfo->NoOfIntegrands; k++) {
+
+        RawSum = ThreadInfo->IntegralOutput[k] / y + ThreadInfo->ReuseRawSum[k];
+        ThreadInfo->IntegralOutput[k] = RawSum * y;
+
+        /* a stride of 1 means this very grid came from the cache */
+        if (ThreadInfo->ReuseStride != 1) {
+            RefineCacheStore (ThreadInfo->RefineCachePath, ThreadInfo->Integrands[k].FunctionID,
+                    ThreadInfo->Integrands[k].Intensity, ThreadInfo->LowerBound, ThreadInfo->UpperBound,
+                    ThreadInfo->NoOfPoints, RawSum);
+        }
+
+        ThreadInfo->ExtrapolationError[k] = -1;
+        if (RefineCacheLookup (ThreadInfo->RefineCachePath, ThreadInfo->Integrands[k].FunctionID,
+                    ThreadInfo->Integrands[k].Intensity, ThreadInfo->LowerBound, ThreadInfo->UpperBound,
+                    ThreadInfo->NoOfPoints, ThreadInfo->NoOfPoints - 1, &CoarsePoints,
+                    &CoarseRawSum) == C_SUCCESS) {
+
+            ThreadInfo->Extrapolated[k] = RefineRichardson (ThreadInfo->IntegralOutput[k],
+                    CoarseRawSum * (ThreadInfo->UpperBound - ThreadInfo->LowerBound) / CoarsePoints,
+                    ThreadInfo->NoOfPoints / CoarsePoints, &ThreadInfo->ExtrapolationError[k]);
+        }
+    }
+}
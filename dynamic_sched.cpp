@@ -5,11 +5,20 @@
  * Version         :1.1
  * To compile :
  *
- * mpicxx -std=c++11 dynamic_sched.cpp -o dynamic_sched libfunctions.a libintegrate.a  
+ * mpicxx -std=c++11 -pthread dynamic_sched.cpp -o dynamic_sched libfunctions.a libintegrate.a  
  * 
  * Sample command line execution :
  * 
  * mpirun -n 3 ./dynamic_sched 1 0 10 1000 1
+ * mpirun -n 3 ./dynamic_sched 1,2,3,4 0 10 1000 1
+ * mpirun -n 3 ./dynamic_sched 1 0 10 1000 1 --repeat 10 --warmup 2
+ * mpirun -n 3 ./dynamic_sched 6 0 10 1000 100 --slow-rank 1:4
+ * mpirun -n 3 ./dynamic_sched 1 0 10 1000 1 --affinity master
+ * mpirun -n 5 ./dynamic_sched 6 0 10 100000 100 --backup --slow-rank 2:8
+ * mpirun -n 5 ./dynamic_sched 6 0 10 10000000 100 --metrics unix:/tmp/progress.sock --metrics-format json
+ * mpirun -n 9 ./dynamic_sched 6 0 10 100000000 100 --tuning sched_tuning.txt
+ * mpirun -n 5 ./dynamic_sched 6 0 10 100000 100 --replay result/sched.log
+ * mpirun -n 9 ./dynamic_sched 6 0 10 10000000 100 --order lpt
  * qsub -d $(pwd) -q mamba -l procs=2 -v FID=1,A=0,B=10,N=1000,INTENSITY=1,PROC=2 ./run_static.sh
  *
  */
@@ -21,6 +30,10 @@
 #define MASTER_TO_SLAVE_WORK_AVAILABLE 1
 #define MASTER_TO_SLAVE_QUIT 2
 #define SLAVE_TO_MASTER_REQ_WORK 3
+/* message from master to slave indicating that its copy of a chunk is no longer needed */
+#define MASTER_TO_SLAVE_CANCEL 4
+/* no of points between two checks for a cancel, in the backup mode */
+#define BACKUP_POLL_POINTS 16
 
 #include <mpi.h>
 #include <stdio.h>
@@ -34,22 +47,15 @@
 #include <cmath>
 
 #include "CommonHeader.h"
+#include "Integrand.h"
+#include "PhaseTimer.h"
+#include "Affinity.h"
+#include "Speculation.h"
+#include "Metrics.h"
+#include "Tuning.h"
+#include "DecisionLog.h"
+#include "CostOrder.h"
 
-#ifdef __cplusplus
-extern "C" {
-#endif
-
-    float f1(float x, int intensity);
-    float f2(float x, int intensity);
-    float f3(float x, int intensity);
-    float f4(float x, int intensity);
-
-#ifdef __cplusplus
-}
-#endif
-
-/* function pointer to one of the following functions : f1, f2, f3, f4 */
-typedef float (*Func) (float, int);
 
 
 typedef struct
@@ -58,7 +64,6 @@ typedef struct
     int StartIndex;
     /* stopping value of the range of indices a thread is supposed to execute */
     int StopIndex;
-    int Intensity;
     /*   !!!!  should this be long ?   */
     int NoOfPoints;
     float LowerBound, UpperBound;
@@ -66,8 +71,26 @@ typedef struct
     //float IntegralOutput;
     /* stores the max value of the index upto which the integral has been computed */
     int CompletedIndex;
-    /* function pointer to one of the following functions : f1, f2, f3, f4 */
-    Func FuncToIntegrate;
+    /* integrands computed in a single pass over the grid */
+    IntegrandSt Integrands[MAX_INTEGRANDS];
+    int NoOfIntegrands;
+    /* result & time taken, filled in by the master */
+    float IntegralOutput[MAX_INTEGRANDS];
+    double ElapsedTime;
+    /* time spent in each phase by this node */
+    PhaseTimerSt Timer;
+    /* once the range is handed out, idle slaves get copies of the outstanding chunks */
+    bool SpeculativeBackup;
+    /* live progress published by the master, disabled if the target is NULL */
+    MetricsConfigSt Metrics;
+    /* decision log written by the master & log replayed instead of the range, NULL if disabled */
+    const char * RecordPath;
+    const char * ReplayPath;
+    /* log being replayed, read by the master only */
+    DecisionLogSt Replay;
+    /* order the master hands out the chunks in, DISPATCH_ORDER_LPT serves them by decreasing cost */
+    int DispatchOrder;
+    CostOrderSt Order;
 
 } ThreadData;
 /*Reference to thread private structure */
@@ -82,6 +105,8 @@ int GetNextLoop (void * inArg);
 static void SlaveWork (void * inArg);
 /* function which will be executed by the master node */
 static void MasterWork (void * inArg);
+/* function to get the next chunk of a slave, from the range or from the replayed log */
+static bool NextChunk (void * inArg, int Node, int * outIndex);
 
 /*==============================================================================
  *  main
@@ -92,55 +117,221 @@ int main (int argc, char* argv[]) {
 
     if (argc < 6) {
         std::cerr<<"Usage: "<<argv[0]<<" <FunctionID> <LowerBound> <UpperBound> \
-            <NoOfPoints> <Intensity> "<<std::endl;
+            <NoOfPoints> <Intensity> [--granularity <Points>] [--tuning <TuningFile>|none] \
+            [--repeat <Trials>] [--warmup <Trials>] \
+            [--slow-rank <Rank>:<Factor>] [--affinity compact|scatter|master] [--backup] \
+            [--metrics <File>|unix:<Socket>] [--metrics-interval <Seconds>] [--metrics-format prom|json] \
+            [--record <LogFile>] [--replay <LogFile>] [--order index|lpt]"<<std::endl;
 
         return -1;
     }
 
     MPI_Init(NULL, NULL);
 
-    int FunctionID;
     int CommSize;
     int ProcRank;
     MPI_Comm_size(MPI_COMM_WORLD, &CommSize);
     MPI_Comm_rank(MPI_COMM_WORLD, &ProcRank);
 
     ThreadData ThreadInfo;
+    int k, Trial;
+    /* the integration is repeated NoOfTrials times after NoOfWarmups unrecorded runs */
+    int NoOfTrials = 1, NoOfWarmups = 0;
+    double TrialTimes[MAX_TRIALS];
+    ThreadInfo.Timer.NoOfTrials = 0;
+    /* slowdown of this node, every integrand is stretched by it (--slow-rank) */
+    double Slowdown = 1;
+    /* placement of the nodes on the cores */
+    int AffinityLayout = AFFINITY_NONE;
+    ThreadInfo.SpeculativeBackup = false;
+    ThreadInfo.Metrics.Target = NULL;
+    ThreadInfo.Metrics.Interval = 1;
+    ThreadInfo.Metrics.Format = METRICS_FORMAT_PROM;
+    ThreadInfo.RecordPath = NULL;
+    ThreadInfo.ReplayPath = NULL;
+    ThreadInfo.DispatchOrder = DISPATCH_ORDER_INDEX;
+    /* status of the replayed log, read by the master */
+    int ReplayStatus = C_SUCCESS;
+    /* chunk size given on the command line, 0 to use the tuned or default one */
+    int Granularity = 0;
+    const char * TuningPath = TUNING_FILE;
+    TuningEntrySt Tuned;
+    int Found = 0;
+
+    for (int Arg = 6; Arg < argc; Arg++) {
+        if (strcmp (argv[Arg], "--repeat") == 0 && Arg + 1 < argc) {
+            NoOfTrials = atoi (argv[++Arg]);
+        }else if (strcmp (argv[Arg], "--warmup") == 0 && Arg + 1 < argc) {
+            NoOfWarmups = atoi (argv[++Arg]);
+        }else if (strcmp (argv[Arg], "--affinity") == 0 && Arg + 1 < argc) {
+            if (AffinityParse (argv[++Arg], &AffinityLayout) != C_SUCCESS) {
+                DLOG(C_ERROR, "Invalid affinity layout %s\n", argv[Arg]);
+                goto EXIT;
+            }
+        }else if (strcmp (argv[Arg], "--slow-rank") == 0 && Arg + 1 < argc) {
+            if (SynthParseSlowdown (argv[++Arg], ProcRank, &Slowdown) != C_SUCCESS) {
+                DLOG(C_ERROR, "Invalid slowdown %s\n", argv[Arg]);
+                goto EXIT;
+            }
+        }else if (strcmp (argv[Arg], "--granularity") == 0 && Arg + 1 < argc) {
+            Granularity = atoi (argv[++Arg]);
+            if (Granularity < 1) {
+                DLOG(C_ERROR, "Invalid granularity %s\n", argv[Arg]);
+                goto EXIT;
+            }
+        }else if (strcmp (argv[Arg], "--tuning") == 0 && Arg + 1 < argc) {
+            TuningPath = argv[++Arg];
+        }else if (strcmp (argv[Arg], "--backup") == 0) {
+            ThreadInfo.SpeculativeBackup = true;
+        }else if (strcmp (argv[Arg], "--record") == 0 && Arg + 1 < argc) {
+            ThreadInfo.RecordPath = argv[++Arg];
+        }else if (strcmp (argv[Arg], "--replay") == 0 && Arg + 1 < argc) {
+            ThreadInfo.ReplayPath = argv[++Arg];
+        }else if (strcmp (argv[Arg], "--order") == 0 && Arg + 1 < argc) {
+            if (CostOrderParse (argv[++Arg], &ThreadInfo.DispatchOrder) != C_SUCCESS) {
+                DLOG(C_ERROR, "Invalid dispatch order %s\n", argv[Arg]);
+                goto EXIT;
+            }
+        }else if (strcmp (argv[Arg], "--metrics") == 0 && Arg + 1 < argc) {
+            ThreadInfo.Metrics.Target = argv[++Arg];
+        }else if (strcmp (argv[Arg], "--metrics-interval") == 0 && Arg + 1 < argc) {
+            ThreadInfo.Metrics.Interval = atof (argv[++Arg]);
+            if (ThreadInfo.Metrics.Interval <= 0) {
+                DLOG(C_ERROR, "Invalid metrics interval %s\n", argv[Arg]);
+                goto EXIT;
+            }
+        }else if (strcmp (argv[Arg], "--metrics-format") == 0 && Arg + 1 < argc) {
+            if (MetricsParseFormat (argv[++Arg], &ThreadInfo.Metrics.Format) != C_SUCCESS) {
+                DLOG(C_ERROR, "Invalid metrics format %s\n", argv[Arg]);
+                goto EXIT;
+            }
+        }else {
+            DLOG(C_ERROR, "Invalid option %s\n", argv[Arg]);
+            goto EXIT;
+        }
+    }
+    if (NoOfTrials < 1 || NoOfTrials > MAX_TRIALS || NoOfWarmups < 0) {
+        DLOG(C_ERROR, "Invalid no of trials\n");
+        goto EXIT;
+    }
+    /* a replay hands out every chunk once, there is no copy to be made */
+    if (ThreadInfo.SpeculativeBackup && ThreadInfo.ReplayPath != NULL) {
+        DLOG(C_ERROR, "--backup & --replay can not be combined\n");
+        goto EXIT;
+    }
+    /* the replayed log fixes the order of the chunks */
+    if (ThreadInfo.DispatchOrder == DISPATCH_ORDER_LPT && ThreadInfo.ReplayPath != NULL) {
+        DLOG(C_ERROR, "--order lpt & --replay can not be combined\n");
+        goto EXIT;
+    }
 
-    FunctionID  = atoi (argv[1]);
     ThreadInfo.LowerBound  = atof (argv[2]);
     ThreadInfo.UpperBound  = atof (argv[3]);
     ThreadInfo.NoOfPoints  = atoi (argv[4]);
-    ThreadInfo.Intensity   = atoi (argv[5]);
-    ThreadInfo.StartIndex = 0;
-    ThreadInfo.StopIndex = 0;
-    ThreadInfo.CompletedIndex = 0;
     /* based on multiple runs of the program,
      * a granularuty of 100 was found to be OK
      */
     ThreadInfo.Granularity = 100;
-    /* based on the input argument, select suitable function to integrate */
-    switch (FunctionID)
-    {
-        case 1:ThreadInfo.FuncToIntegrate = f1;
-               break;
-        case 2:ThreadInfo.FuncToIntegrate = f2;
-               break;
-        case 3:ThreadInfo.FuncToIntegrate = f3;
-               break;
-        case 4:ThreadInfo.FuncToIntegrate = f4;
-               break;
-
-        default: 
-               DLOG(C_ERROR, "Invalid function input for integration\n");
-               goto EXIT;
+    /* based on the input argument, select suitable functions to integrate */
+    if (ParseIntegrands (argv[1], argv[5], ThreadInfo.Integrands, &ThreadInfo.NoOfIntegrands) != C_SUCCESS) {
+        DLOG(C_ERROR, "Invalid function input for integration\n");
+        goto EXIT;
+    }
+    SynthConfigure (ThreadInfo.LowerBound, ThreadInfo.UpperBound, Slowdown);
+
+    /* the granularity tuned for the dynamic policy by advnc_sched --autotune, only the master reads the file */
+    if (Granularity == 0 && strcmp (TuningPath, "none") != 0) {
+        if (ProcRank == MASTER_NODE) {
+            Found = (TuningLookup (TuningPath, argv[1], argv[5], ThreadInfo.NoOfPoints, CommSize,
+                        "dynamic", &Tuned) == C_SUCCESS);
+            Granularity = Found ? (int) Tuned.Granularity : 0;
+        }
+        MPI_Bcast (&Granularity, 1, MPI_INT, MASTER_NODE, MPI_COMM_WORLD);
+    }
+    if (Granularity > 0) {
+        ThreadInfo.Granularity = Granularity;
+    }
+
+    /* this scheduler has no static prefix, only the master reads the log */
+    if (ThreadInfo.ReplayPath != NULL) {
+        if (ProcRank == MASTER_NODE) {
+            ReplayStatus = DecisionLogRead (&ThreadInfo.Replay, ThreadInfo.ReplayPath);
+            if (ReplayStatus == C_SUCCESS) {
+                ReplayStatus = (ThreadInfo.Replay.Header.StaticPoints == 0) ?
+                    DecisionLogCheck (&ThreadInfo.Replay, CommSize, ThreadInfo.NoOfPoints) : C_INVALID_ARGS;
+                if (ReplayStatus != C_SUCCESS) {
+                    DecisionLogFree (&ThreadInfo.Replay);
+                }
+            }
+        }
+        MPI_Bcast (&ReplayStatus, 1, MPI_INT, MASTER_NODE, MPI_COMM_WORLD);
+        if (ReplayStatus != C_SUCCESS) {
+            DLOG(C_ERROR, "Unable to replay %s with %d nodes & %d points\n", ThreadInfo.ReplayPath,
+                    CommSize, ThreadInfo.NoOfPoints);
+            goto EXIT;
+        }
+    }
+
+    /* pin the node before any buffer is allocated, so that the buffers are first touched on its core */
+    if (AffinityLayout != AFFINITY_NONE) {
+        AffinityBind (AffinityLayout, MPI_COMM_WORLD, MASTER_NODE);
+        AffinityReport (MPI_COMM_WORLD, MASTER_NODE, stdout);
     }
 
+    /* the cost of the range is sampled once for all the trials */
+    if (ThreadInfo.DispatchOrder == DISPATCH_ORDER_LPT) {
+        double ProbeTimes[COST_ORDER_BUCKETS];
+        CostOrderInit (&ThreadInfo.Order, 0, ThreadInfo.NoOfPoints, ThreadInfo.Granularity);
+        CostOrderProbe (&ThreadInfo.Order, ProcRank - 1, CommSize - 1, ThreadInfo.Integrands,
+                ThreadInfo.NoOfIntegrands, ThreadInfo.LowerBound, ThreadInfo.UpperBound, ThreadInfo.NoOfPoints,
+                ProbeTimes);
+        MPI_Reduce (ProbeTimes, ThreadInfo.Order.Cost, ThreadInfo.Order.NoOfBuckets, MPI_DOUBLE, MPI_MIN,
+                MASTER_NODE, MPI_COMM_WORLD);
+        if (ProcRank == MASTER_NODE) {
+            CostOrderSort (&ThreadInfo.Order);
+        }
+    }
+
+    for (Trial = 0; Trial < NoOfWarmups + NoOfTrials; Trial++) {
+
+        ThreadInfo.StartIndex = 0;
+        ThreadInfo.StopIndex = 0;
+        ThreadInfo.CompletedIndex = 0;
+        if (ThreadInfo.DispatchOrder == DISPATCH_ORDER_LPT) {
+            CostOrderRewind (&ThreadInfo.Order);
+        }
+        PhaseTimerBeginTrial (&ThreadInfo.Timer);
+
+        MPI_Barrier( MPI_COMM_WORLD ) ;
+
+        if (ProcRank == MASTER_NODE){
+            MasterWork(&ThreadInfo);
+            if (Trial >= NoOfWarmups) {
+                TrialTimes[Trial - NoOfWarmups] = ThreadInfo.ElapsedTime;
+            }
+        }else{
+            SlaveWork(&ThreadInfo);
+        }
 
+        PhaseTimerEndTrial (&ThreadInfo.Timer, Trial >= NoOfWarmups);
+    }
+
+    /* display the sum of the last trial & the median time taken to compute it,
+     * the phase breakdown goes to stdout */
     if (ProcRank == MASTER_NODE){
-        MasterWork(&ThreadInfo);
-    }else{
-        SlaveWork(&ThreadInfo);
+        for (k = 0; k < ThreadInfo.NoOfIntegrands; k++) {
+            std::cout<<ThreadInfo.IntegralOutput[k]<<std::endl;
+        }
+        std::cerr<<PhaseTimerMedian (TrialTimes, NoOfTrials)<<std::endl;
+    }
+    if (NoOfWarmups + NoOfTrials > 1) {
+        PhaseTimerReport (&ThreadInfo.Timer, MPI_COMM_WORLD, MASTER_NODE, stdout);
+    }
+    if (ProcRank == MASTER_NODE && ThreadInfo.ReplayPath != NULL) {
+        DecisionLogFree (&ThreadInfo.Replay);
+    }
+    if (ThreadInfo.DispatchOrder == DISPATCH_ORDER_LPT) {
+        CostOrderFree (&ThreadInfo.Order);
     }
 
 EXIT:
@@ -158,6 +349,7 @@ EXIT:
 static void MasterWork (void * inArg){
 
     RefThreadData ThreadInfo = (RefThreadData)inArg;
+    PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_SETUP);
     /* receive a message from slave requesting work */
     /* check if work is available */
     /* if work is available send the work struct to slave */
@@ -172,44 +364,117 @@ static void MasterWork (void * inArg){
     int * Index;
     Index = new int [2];
     int QuitCounter = 0;
+    int k, NoOfIntegrands = ThreadInfo->NoOfIntegrands;
+    int Node, Other;
+
+    /* the chunk outstanding at every slave, used by the backup mode */
+    SpecSt Spec = {0};
+    long ChunkStart;
+    int SpecResult = SPEC_FIRST;
+    if (ThreadInfo->SpeculativeBackup) {
+        SpecInit (&Spec, CommSize, 1);
+    }
+    /* progress published by a separate thread, a slave has a chunk once it has been sent one */
+    MetricsSt Metrics;
+    /* decisions of this trial, written out with --record */
+    DecisionLogSt Record;
+    bool * HasChunk = new bool [CommSize];
+    memset (HasChunk, 0, CommSize * sizeof(HasChunk[0]));
 
     float * IntegralOutput;
     float * NodeIntegralOutput;
-    IntegralOutput = new float [1];
-    NodeIntegralOutput = new float [1];
-    memset (IntegralOutput, 0, sizeof(IntegralOutput[0]));
-    memset (NodeIntegralOutput, 0, sizeof(NodeIntegralOutput[0]));
+    IntegralOutput = new float [NoOfIntegrands];
+    NodeIntegralOutput = new float [NoOfIntegrands];
+    memset (IntegralOutput, 0, NoOfIntegrands * sizeof(IntegralOutput[0]));
+    memset (NodeIntegralOutput, 0, NoOfIntegrands * sizeof(NodeIntegralOutput[0]));
 
     /* measure time taken for integration */
-    std::chrono::time_point<std::chrono::system_clock> StartTime;
-    std::chrono::time_point<std::chrono::system_clock>  EndTime;
+    std::chrono::time_point<std::chrono::steady_clock> StartTime;
+    std::chrono::time_point<std::chrono::steady_clock>  EndTime;
     std::chrono::duration<double> ElapsedTime;
-    StartTime = std::chrono::system_clock::now();
+    StartTime = std::chrono::steady_clock::now();
+    MetricsStart (&Metrics, &ThreadInfo->Metrics, CommSize, 1, ThreadInfo->NoOfPoints);
+    if (ThreadInfo->RecordPath != NULL) {
+        DecisionLogInit (&Record, CommSize, ThreadInfo->NoOfPoints, 0);
+    }
+    if (ThreadInfo->ReplayPath != NULL) {
+        DecisionLogRewind (&ThreadInfo->Replay);
+    }
 
     while (1) {
 
-        MPI_Recv (NodeIntegralOutput, 1, MPI_FLOAT, MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD,&status);
+        PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_REDUCTION);
+        MetricsIdleBegin (&Metrics);
+        MPI_Recv (NodeIntegralOutput, NoOfIntegrands, MPI_FLOAT, MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD,&status);
+        MetricsIdleEnd (&Metrics);
+        Node = status.MPI_SOURCE;
+        if (HasChunk[Node]) {
+            HasChunk[Node] = false;
+            if (ThreadInfo->RecordPath != NULL) {
+                DecisionLogCompleted (&Record, Node);
+            }
+        }
 
-        IntegralOutput[0] = IntegralOutput[0] + NodeIntegralOutput[0];
+        if (ThreadInfo->SpeculativeBackup) {
+            /* only the first copy of a chunk counts, the others are cancelled */
+            SpecResult = SpecCompleted (&Spec, Node, &ChunkStart);
+            if (SpecResult == SPEC_FIRST) {
+                for (Other = 1; Other < CommSize; Other++) {
+                    if (SpecHasCopy (&Spec, Other, ChunkStart)) {
+                        DLOG (C_VERBOSE, "Node[master] cancelling chunk %ld at node %d\n", ChunkStart, Other);
+                        Index[0] = ChunkStart;
+                        MPI_Send(Index, 2, MPI_INT, Other, MASTER_TO_SLAVE_CANCEL, MPI_COMM_WORLD);
+                        Spec.NoOfCancels++;
+                    }
+                }
+            }
+        }
+        /* a copy whose result is dropped only counts as a chunk back */
+        MetricsCompleted (&Metrics, Node, SpecResult != SPEC_DUPLICATE);
+        /* outside the backup mode the results stay at the slaves until the final reduce */
+        if (ThreadInfo->SpeculativeBackup && SpecResult != SPEC_DUPLICATE) {
+            for (k = 0; k < NoOfIntegrands; k++) {
+                IntegralOutput[k] = IntegralOutput[k] + NodeIntegralOutput[k];
+            }
+        }
         DLOG (C_VERBOSE, "Node[master] IntegralOutput = %f, NodeIntegralOutput = %f\n", IntegralOutput[0], NodeIntegralOutput[0]);
 
-        if (!IsLoopDone(ThreadInfo)) {
+        PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_DISTRIBUTION);
+        if (NextChunk (ThreadInfo, Node, Index)) {
 
             DLOG (C_VERBOSE, "Node[master] Work Is Available. sending work to node :%d\n", status.MPI_SOURCE);
 
-            GetNextLoop (ThreadInfo);
-
-            Index[0] = ThreadInfo->StartIndex;
-            Index[1] = ThreadInfo->StopIndex;
-
             DLOG (C_VERBOSE, "Node[master] StartIndex = %d StopIndex = %d\n", Index[0], Index[1]);
 
             MPI_Send(Index, 2, MPI_INT, status.MPI_SOURCE, MASTER_TO_SLAVE_WORK_AVAILABLE, MPI_COMM_WORLD);
+            MetricsDispatched (&Metrics, Node, Index[1] - Index[0]);
+            HasChunk[Node] = true;
+            if (ThreadInfo->SpeculativeBackup) {
+                SpecDispatched (&Spec, Node, Index[0]);
+            }
+            if (ThreadInfo->RecordPath != NULL) {
+                DecisionLogDispatched (&Record, Node, Index[0], Index[1], 0);
+            }
+
+        }else if (ThreadInfo->SpeculativeBackup && SpecPickBackup (&Spec, Node, &ChunkStart)) {
+
+            /* no fresh work left, the slave computes a copy of a straggling chunk */
+            DLOG (C_VERBOSE, "Node[master] reissuing chunk %ld to node :%d\n", ChunkStart, Node);
+            Index[0] = ChunkStart;
+            Index[1] = std::min (Index[0] + ThreadInfo->Granularity, ThreadInfo->NoOfPoints);
+            MPI_Send(Index, 2, MPI_INT, Node, MASTER_TO_SLAVE_WORK_AVAILABLE, MPI_COMM_WORLD);
+            SpecDispatched (&Spec, Node, ChunkStart);
+            MetricsDispatched (&Metrics, Node, Index[1] - Index[0]);
+            HasChunk[Node] = true;
+            if (ThreadInfo->RecordPath != NULL) {
+                DecisionLogDispatched (&Record, Node, Index[0], Index[1], DECISION_BACKUP_COPY);
+            }
 
         }else {
 
             DLOG (C_VERBOSE, "Node[master] Work Is not Available. sending quit to node :%d\n", status.MPI_SOURCE);
 
+            PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_SHUTDOWN);
             MPI_Send(Index, 2, MPI_INT, status.MPI_SOURCE, MASTER_TO_SLAVE_QUIT, MPI_COMM_WORLD);
             QuitCounter++;
         }
@@ -220,13 +485,34 @@ static void MasterWork (void * inArg){
         }
     }
 
-    /* compute the time taken to compute the sum and display the same */
-    EndTime = std::chrono::system_clock::now();
+    /* combine the sums accumulated by the slaves */
+    PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_REDUCTION);
+    MPI_Reduce (MPI_IN_PLACE, IntegralOutput, NoOfIntegrands, MPI_FLOAT, MPI_SUM, MASTER_NODE, MPI_COMM_WORLD);
+
+    /* compute the time taken to compute the sum */
+    EndTime = std::chrono::steady_clock::now();
     ElapsedTime = EndTime - StartTime;
 
-    std::cout<<IntegralOutput[0]<<std::endl;
-    std::cerr<<ElapsedTime.count()<<std::endl;
+    PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_SHUTDOWN);
+    MetricsStop (&Metrics);
+    memcpy (ThreadInfo->IntegralOutput, IntegralOutput, NoOfIntegrands * sizeof(IntegralOutput[0]));
+    ThreadInfo->ElapsedTime = ElapsedTime.count();
+
+    /* every trial overwrites the log, the last one is kept */
+    if (ThreadInfo->RecordPath != NULL) {
+        if (DecisionLogWrite (&Record, ThreadInfo->RecordPath) != C_SUCCESS) {
+            DLOG(C_ERROR, "Unable to write %s\n", ThreadInfo->RecordPath);
+        }
+        DecisionLogFree (&Record);
+    }
+
+    if (ThreadInfo->SpeculativeBackup) {
+        DLOG (C_VERBOSE, "Node[master] %ld chunks reissued, %ld copies cancelled\n",
+                Spec.NoOfBackups, Spec.NoOfCancels);
+        SpecFree (&Spec);
+    }
 
+    delete[] HasChunk;
     delete[] NodeIntegralOutput;
     delete[] IntegralOutput;
     delete[] Index;
@@ -240,6 +526,7 @@ static void MasterWork (void * inArg){
 static void SlaveWork (void * inArg){
 
     RefThreadData ThreadInfo = (RefThreadData)inArg;
+    PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_SETUP);
 
     /* send a mmessage to master, requesting work */
     /* terminate if the message from master says so */
@@ -249,14 +536,23 @@ static void SlaveWork (void * inArg){
     MPI_Comm_size(MPI_COMM_WORLD, &CommSize);
     MPI_Comm_rank(MPI_COMM_WORLD, &ProcRank);
     MPI_Status status;
+    int Flag;
 
     int * Index;
     Index = new int [2];
-    int i, StartIndex, StopIndex;
+    int i, k, StartIndex, StopIndex;
+    int NoOfIntegrands = ThreadInfo->NoOfIntegrands;
 
     float * NodeIntegralOutput;
-    NodeIntegralOutput = new float [1];
-    memset (NodeIntegralOutput, 0, sizeof(NodeIntegralOutput[0]));
+    NodeIntegralOutput = new float [NoOfIntegrands];
+    memset (NodeIntegralOutput, 0, NoOfIntegrands * sizeof(NodeIntegralOutput[0]));
+    /* sum over all the chunks computed by this slave, combined with MPI_Reduce at the end */
+    float LocalIntegral[MAX_INTEGRANDS];
+    memset (LocalIntegral, 0, sizeof(LocalIntegral));
+    /* start of the chunk being computed, stretched by --slow-rank */
+    std::chrono::steady_clock::time_point ChunkStart;
+    /* a result is only shipped with the work request in the backup mode, where the master picks the first copy */
+    int ResultCount = ThreadInfo->SpeculativeBackup ? NoOfIntegrands : 0;
 
     float y, x, FuncOutput;
 
@@ -266,11 +562,16 @@ static void SlaveWork (void * inArg){
     while (1){
 
         DLOG (C_VERBOSE, "Node[%d] Sending integration %f y = %f\n", ProcRank, NodeIntegralOutput[0], y);
-        MPI_Send (NodeIntegralOutput, 1, MPI_FLOAT, MASTER_NODE, SLAVE_TO_MASTER_REQ_WORK, MPI_COMM_WORLD);
+        PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_REDUCTION);
+        MPI_Send (NodeIntegralOutput, ResultCount, MPI_FLOAT, MASTER_NODE, SLAVE_TO_MASTER_REQ_WORK, MPI_COMM_WORLD);
 
-        memset (NodeIntegralOutput, 0, sizeof(NodeIntegralOutput[0]));
+        memset (NodeIntegralOutput, 0, NoOfIntegrands * sizeof(NodeIntegralOutput[0]));
 
-        MPI_Recv (Index, 2, MPI_INT, MASTER_NODE, MPI_ANY_TAG, MPI_COMM_WORLD,&status);
+        PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_DISTRIBUTION);
+        do {
+            /* a cancel arriving after the chunk was reported comes ahead of the reply */
+            MPI_Recv (Index, 2, MPI_INT, MASTER_NODE, MPI_ANY_TAG, MPI_COMM_WORLD,&status);
+        } while (status.MPI_TAG == MASTER_TO_SLAVE_CANCEL);
 
         if (status.MPI_TAG == MASTER_TO_SLAVE_WORK_AVAILABLE) {
 
@@ -279,13 +580,31 @@ static void SlaveWork (void * inArg){
             StopIndex = Index[1];
             DLOG (C_VERBOSE, "Node[%d] StartIndex = %d StopIndex = %d\n", ProcRank, StartIndex, StopIndex);
 
-
+            PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_COMPUTE);
+            ChunkStart = std::chrono::steady_clock::now();
             for (i=StartIndex; i< StopIndex; i++) {
+                if (ThreadInfo->SpeculativeBackup && (i - StartIndex) % BACKUP_POLL_POINTS == 0) {
+                    /* a cancel can only be for the chunk being computed, the result is then ignored */
+                    MPI_Iprobe (MASTER_NODE, MASTER_TO_SLAVE_CANCEL, MPI_COMM_WORLD, &Flag, &status);
+                    if (Flag) {
+                        MPI_Recv (Index, 2, MPI_INT, MASTER_NODE, MASTER_TO_SLAVE_CANCEL, MPI_COMM_WORLD, &status);
+                        DLOG (C_VERBOSE, "Node[%d] chunk %d cancelled\n", ProcRank, StartIndex);
+                        break;
+                    }
+                }
                 x = (ThreadInfo->LowerBound + ((i + 0.5)* y ));
-                FuncOutput = ThreadInfo->FuncToIntegrate (x,ThreadInfo->Intensity );
-                NodeIntegralOutput[0] += FuncOutput;
+                for (k = 0; k < NoOfIntegrands; k++) {
+                    FuncOutput = ThreadInfo->Integrands[k].FuncToIntegrate (x, ThreadInfo->Integrands[k].Intensity);
+                    NodeIntegralOutput[k] += FuncOutput;
+                }
+            }
+            SynthStretch (ChunkStart);
+            for (k = 0; k < NoOfIntegrands; k++) {
+                NodeIntegralOutput[k] = NodeIntegralOutput[k] * y;
+                if (!ThreadInfo->SpeculativeBackup) {
+                    LocalIntegral[k] += NodeIntegralOutput[k];
+                }
             }
-            NodeIntegralOutput[0] = NodeIntegralOutput[0] * y;
 
         }else if (status.MPI_TAG == MASTER_TO_SLAVE_QUIT) {
             DLOG (C_VERBOSE, "Quit message received from master. Node %d exiting\n", ProcRank);
@@ -294,10 +613,42 @@ static void SlaveWork (void * inArg){
 
     }
 
+    PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_REDUCTION);
+    MPI_Reduce (LocalIntegral, NULL, NoOfIntegrands, MPI_FLOAT, MPI_SUM, MASTER_NODE, MPI_COMM_WORLD);
+
+    PhaseTimerSwitch (&ThreadInfo->Timer, PHASE_SHUTDOWN);
     delete[] NodeIntegralOutput;
     delete[] Index;
 }
 
+/*==============================================================================
+ *  NextChunk
+ *=============================================================================*/
+
+/* next chunk to be sent to Node as {start, stop}, returns false if there is none left for it */
+static bool NextChunk (void * inArg, int Node, int * outIndex)
+{
+    RefThreadData ThreadInfo = (RefThreadData)inArg;
+    long StartIndex, StopIndex;
+
+    if (ThreadInfo->ReplayPath != NULL) {
+        if (!DecisionLogNext (&ThreadInfo->Replay, Node, &StartIndex, &StopIndex)) {
+            return false;
+        }
+        outIndex[0] = (int) StartIndex;
+        outIndex[1] = (int) StopIndex;
+        return true;
+    }
+    if (IsLoopDone (ThreadInfo)) {
+        return false;
+    }
+    GetNextLoop (ThreadInfo);
+    outIndex[0] = ThreadInfo->StartIndex;
+    outIndex[1] = ThreadInfo->StopIndex;
+
+    return true;
+}
+
 /*==============================================================================
  *  IsLoopDone
  *=============================================================================*/
@@ -308,7 +659,11 @@ bool IsLoopDone (void * inArg)
     RefThreadData ThreadInfo = (RefThreadData)inArg;
 
     DLOG (C_VERBOSE, "ThreadInfo->CompletedIndex = %d\n", ThreadInfo->CompletedIndex);
-    if (ThreadInfo->CompletedIndex == ThreadInfo->NoOfPoints){
+    if (ThreadInfo->DispatchOrder == DISPATCH_ORDER_LPT) {
+        /* the chunks handed out are not a prefix of the range */
+        C_Status = CostOrderDone (&ThreadInfo->Order);
+    }
+    else if (ThreadInfo->CompletedIndex == ThreadInfo->NoOfPoints){
         C_Status = true;
     }
     else{
@@ -328,9 +683,17 @@ int GetNextLoop (void * inArg)
 {
     int C_Status = C_SUCCESS; 
     RefThreadData ThreadInfo = (RefThreadData)inArg;
+    long StartIndex, StopIndex;
 
     DLOG (C_VERBOSE, "Granularity = %d\n",ThreadInfo->Granularity);
 
+    if (ThreadInfo->DispatchOrder == DISPATCH_ORDER_LPT) {
+        CostOrderNext (&ThreadInfo->Order, &StartIndex, &StopIndex);
+        ThreadInfo->StartIndex = (int) StartIndex;
+        ThreadInfo->StopIndex = (int) StopIndex;
+        return C_Status;
+    }
+
     ThreadInfo->StartIndex = ThreadInfo->CompletedIndex;
     ThreadInfo->StopIndex = ThreadInfo->CompletedIndex + ThreadInfo->Granularity;
 
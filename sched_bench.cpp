@@ -0,0 +1,450 @@
+/*
+ * File Name       :sched_bench.cpp
+ * Description     :Microbenchmarks of the message path of the master-worker
+ *                  schedulers
+ * Author          :Karthik Rao
+ * Version         :0.1
+ * To compile :
+ *
+ * mpicxx -std=c++11 -O2 sched_bench.cpp -o sched_bench
+ *
+ * Sample command line execution :
+ *
+ * mpirun -n 2 ./sched_bench latency --iterations 100000
+ * mpirun -n 2 ./sched_bench datatype
+ * mpirun -n 33 ./sched_bench dispatch --workers 1,2,4,8,16,32 --prefetch 3
+ * mpirun -n 9 ./sched_bench prefetch --depths 1,2,3,4,6,8 --chunks 200000
+ *
+ * The benchmarks use the messages of advnc_sched (tags, chunks as a raw
+ * MPI_LONG[2], empty work requests & exit messages) with an empty kernel, so
+ * only the protocol is measured :
+ *
+ * latency  : round trip of a single chunk, work request from node 1 to the
+ *            master & MPI_LONG[2] reply, timed at node 1
+ * datatype : the same round trip with a raw MPI_LONG[2] & with the IndexSt
+ *            derived datatype advnc_sched used to send the chunks with
+ * dispatch : chunks handed out per second by the master to 1, 2, 4 ... P-1
+ *            workers with the prefetch depth of advnc_sched, on a
+ *            sub-communicator of the first nodes
+ * prefetch : chunks per second with all the P-1 workers, for every prefetch
+ *            depth of --depths
+ *
+ * Every measurement is repeated, the round trips --iterations times & the
+ * dispatch runs --trials times of --chunks chunks, after an unrecorded
+ * warmup. One line is printed to stdout per configuration with the
+ * percentiles of the samples.
+ */
+
+/* Debug prints will be enabled if set to 1 */
+#define DEBUG 0
+/* max no of processors available in the system */
+#define MAX_PROCESSORS 32
+/* max no of chunk of work available at the slave at any point of time */
+#define MAX_CHUNK 8
+/* prefetch depth of advnc_sched */
+#define DEFAULT_PREFETCH_DEPTH 3
+/* rank of the master node */
+#define MASTER_NODE 0
+/* tags of advnc_sched */
+#define MASTER_TO_SLAVE_WORK_AVAILABLE 1000
+#define MASTER_TO_SLAVE_QUIT 2000
+#define SLAVE_TO_MASTER_REQ_WORK 3000
+#define SLAVE_TO_MASTER_EXITING 4000
+/* default no of round trips, of chunks per dispatch run & of dispatch runs */
+#define BENCH_ITERATIONS 10000
+#define BENCH_CHUNKS 100000
+#define BENCH_TRIALS 10
+/* max no of values of --workers & --depths */
+#define BENCH_MAX_LIST 16
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <chrono>
+#include <string.h>
+#include <stddef.h>
+#include <algorithm>
+
+#include "CommonHeader.h"
+#include "Integrand.h"
+
+typedef struct
+{
+    long StartIndex;
+    long StopIndex;
+
+} IndexSt;
+/* Reference to Index structure */
+typedef IndexSt * RefIndexSt;
+
+typedef struct
+{
+    int Iterations;
+    long Chunks;
+    int Trials;
+    int PrefetchDepth;
+    int Workers[BENCH_MAX_LIST];
+    int NoOfWorkers;
+    int Depths[BENCH_MAX_LIST];
+    int NoOfDepths;
+
+} BenchConfigSt;
+/* Reference to benchmark configuration structure */
+typedef BenchConfigSt * RefBenchConfigSt;
+
+/* function to create the datatype of IndexSt, as in the work stealing mode of advnc_sched */
+static void CreateIndexType (MPI_Datatype * outType);
+/* function to time round trips of a single chunk between node 1 & the master */
+static void BenchRoundTrip (RefBenchConfigSt Config, MPI_Datatype Type, int Count, const char * Name);
+/* function to time the dispatch of chunks to the first NoOfWorkers workers */
+static void BenchDispatch (RefBenchConfigSt Config, int NoOfWorkers, int PrefetchDepth, const char * Name);
+/* function which serves chunks like the master of advnc_sched, returns the time taken */
+static double BenchMaster (MPI_Comm Comm, long Chunks, int PrefetchDepth);
+/* function which requests chunks like a slave of advnc_sched, with an empty kernel */
+static void BenchSlave (MPI_Comm Comm, int PrefetchDepth);
+/* function to print the percentiles of a set of samples, sorts them */
+static void BenchReport (const char * Name, int Param, double * Samples, int Count, double Scale);
+
+/*==============================================================================
+ *  main
+ *=============================================================================*/
+
+int main (int argc, char* argv[]) {
+
+    if (argc < 2) {
+        std::cerr<<"Usage: "<<argv[0]<<" latency|datatype|dispatch|prefetch \
+            [--iterations <N>] [--chunks <N>] [--trials <N>] [--prefetch <Chunks>] \
+            [--workers <W>[,<W>...]] [--depths <D>[,<D>...]]"<<std::endl;
+
+        return -1;
+    }
+
+    MPI_Init(NULL, NULL);
+
+    int CommSize, ProcRank, i;
+    MPI_Comm_size(MPI_COMM_WORLD, &CommSize);
+    MPI_Comm_rank(MPI_COMM_WORLD, &ProcRank);
+    const char * Bench = argv[1];
+    BenchConfigSt Config;
+    MPI_Datatype StructOfIndex;
+
+    Config.Iterations = BENCH_ITERATIONS;
+    Config.Chunks = BENCH_CHUNKS;
+    Config.Trials = BENCH_TRIALS;
+    Config.PrefetchDepth = DEFAULT_PREFETCH_DEPTH;
+    /* 1, 2, 4 ... workers & all of them */
+    Config.NoOfWorkers = 0;
+    for (i = 1; i < CommSize && Config.NoOfWorkers < BENCH_MAX_LIST - 1; i *= 2) {
+        Config.Workers[Config.NoOfWorkers++] = i;
+    }
+    if (CommSize > 1 && Config.Workers[Config.NoOfWorkers - 1] != CommSize - 1) {
+        Config.Workers[Config.NoOfWorkers++] = CommSize - 1;
+    }
+    Config.NoOfDepths = 0;
+    for (i = 1; i <= MAX_CHUNK; i++) {
+        Config.Depths[Config.NoOfDepths++] = i;
+    }
+
+    for (int Arg = 2; Arg < argc; Arg++) {
+        if (strcmp (argv[Arg], "--iterations") == 0 && Arg + 1 < argc) {
+            Config.Iterations = atoi (argv[++Arg]);
+        }else if (strcmp (argv[Arg], "--chunks") == 0 && Arg + 1 < argc) {
+            Config.Chunks = atol (argv[++Arg]);
+        }else if (strcmp (argv[Arg], "--trials") == 0 && Arg + 1 < argc) {
+            Config.Trials = atoi (argv[++Arg]);
+        }else if (strcmp (argv[Arg], "--prefetch") == 0 && Arg + 1 < argc) {
+            Config.PrefetchDepth = atoi (argv[++Arg]);
+        }else if (strcmp (argv[Arg], "--workers") == 0 && Arg + 1 < argc) {
+            Config.NoOfWorkers = ParseIntList (argv[++Arg], Config.Workers, BENCH_MAX_LIST);
+        }else if (strcmp (argv[Arg], "--depths") == 0 && Arg + 1 < argc) {
+            Config.NoOfDepths = ParseIntList (argv[++Arg], Config.Depths, BENCH_MAX_LIST);
+        }else {
+            DLOG(C_ERROR, "Invalid option %s\n", argv[Arg]);
+            goto EXIT;
+        }
+    }
+
+    if (CommSize < 2 || CommSize > MAX_PROCESSORS) {
+        DLOG(C_ERROR, "The benchmarks need 2 to %d nodes\n", MAX_PROCESSORS);
+        goto EXIT;
+    }
+    if (Config.Iterations < 1 || Config.Chunks < 1 || Config.Trials < 1 ||
+            Config.PrefetchDepth < 1 || Config.PrefetchDepth > MAX_CHUNK ||
+            Config.NoOfWorkers < 1 || Config.NoOfDepths < 1) {
+        DLOG(C_ERROR, "Invalid benchmark parameters\n");
+        goto EXIT;
+    }
+    for (i = 0; i < Config.NoOfWorkers; i++) {
+        if (Config.Workers[i] < 1 || Config.Workers[i] >= CommSize) {
+            DLOG(C_ERROR, "Invalid no of workers %d, at most %d\n", Config.Workers[i], CommSize - 1);
+            goto EXIT;
+        }
+    }
+    for (i = 0; i < Config.NoOfDepths; i++) {
+        if (Config.Depths[i] < 1 || Config.Depths[i] > MAX_CHUNK) {
+            DLOG(C_ERROR, "Invalid prefetch depth %d, at most %d\n", Config.Depths[i], MAX_CHUNK);
+            goto EXIT;
+        }
+    }
+
+    if (ProcRank == MASTER_NODE) {
+        std::cout<<"# "<<Bench<<" benchmark, "<<CommSize<<" nodes"<<std::endl;
+    }
+
+    if (strcmp (Bench, "latency") == 0) {
+        if (ProcRank == MASTER_NODE) {
+            std::cout<<"# name param count p50 p90 p99 min max (us)"<<std::endl;
+        }
+        BenchRoundTrip (&Config, MPI_LONG, 2, "long2");
+    }else if (strcmp (Bench, "datatype") == 0) {
+        if (ProcRank == MASTER_NODE) {
+            std::cout<<"# name param count p50 p90 p99 min max (us)"<<std::endl;
+        }
+        CreateIndexType (&StructOfIndex);
+        BenchRoundTrip (&Config, MPI_LONG, 2, "long2");
+        BenchRoundTrip (&Config, StructOfIndex, 1, "indexst");
+        MPI_Type_free(&StructOfIndex);
+    }else if (strcmp (Bench, "dispatch") == 0) {
+        /* the param is the no of workers */
+        if (ProcRank == MASTER_NODE) {
+            std::cout<<"# name workers count p50 p90 p99 min max (chunks/s)"<<std::endl;
+        }
+        for (i = 0; i < Config.NoOfWorkers; i++) {
+            BenchDispatch (&Config, Config.Workers[i], Config.PrefetchDepth, "dispatch");
+        }
+    }else if (strcmp (Bench, "prefetch") == 0) {
+        /* the param is the prefetch depth */
+        if (ProcRank == MASTER_NODE) {
+            std::cout<<"# name depth count p50 p90 p99 min max (chunks/s)"<<std::endl;
+        }
+        for (i = 0; i < Config.NoOfDepths; i++) {
+            BenchDispatch (&Config, CommSize - 1, Config.Depths[i], "prefetch");
+        }
+    }else {
+        DLOG(C_ERROR, "Invalid benchmark %s\n", Bench);
+    }
+
+EXIT:
+    MPI_Finalize();
+
+    return 0;
+}
+
+/*==============================================================================
+ *  BenchRoundTrip
+ *=============================================================================*/
+
+/*
+ * node 1 sends an empty work request & waits for the chunk, the master answers
+ * every request at once. the other nodes stay out of the way.
+ */
+static void BenchRoundTrip (RefBenchConfigSt Config, MPI_Datatype Type, int Count, const char * Name)
+{
+    int ProcRank, Iteration;
+    IndexSt Index = {0, 0};
+    double * Samples = NULL;
+    std::chrono::time_point<std::chrono::steady_clock> StartTime;
+    std::chrono::duration<double> ElapsedTime;
+
+    MPI_Comm_rank(MPI_COMM_WORLD, &ProcRank);
+    if (ProcRank == 1) {
+        Samples = new double [Config->Iterations];
+    }
+    MPI_Barrier (MPI_COMM_WORLD);
+
+    /* the first Iterations / 10 round trips are a warmup */
+    for (Iteration = -Config->Iterations / 10; Iteration < Config->Iterations; Iteration++) {
+        if (ProcRank == MASTER_NODE) {
+            MPI_Recv (NULL, 0, MPI_DOUBLE, 1, SLAVE_TO_MASTER_REQ_WORK, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            Index.StartIndex += 100;
+            Index.StopIndex = Index.StartIndex + 100;
+            MPI_Send (&Index, Count, Type, 1, MASTER_TO_SLAVE_WORK_AVAILABLE, MPI_COMM_WORLD);
+        }else if (ProcRank == 1) {
+            StartTime = std::chrono::steady_clock::now();
+            MPI_Send (NULL, 0, MPI_DOUBLE, MASTER_NODE, SLAVE_TO_MASTER_REQ_WORK, MPI_COMM_WORLD);
+            MPI_Recv (&Index, Count, Type, MASTER_NODE, MASTER_TO_SLAVE_WORK_AVAILABLE, MPI_COMM_WORLD,
+                    MPI_STATUS_IGNORE);
+            ElapsedTime = std::chrono::steady_clock::now() - StartTime;
+            if (Iteration >= 0) {
+                Samples[Iteration] = ElapsedTime.count();
+            }
+        }
+    }
+
+    /* the samples are at node 1, the report is printed there in turn */
+    if (ProcRank == 1) {
+        BenchReport (Name, Count, Samples, Config->Iterations, 1e6);
+        fflush (stdout);
+        delete[] Samples;
+    }
+    MPI_Barrier (MPI_COMM_WORLD);
+}
+
+/*==============================================================================
+ *  BenchDispatch
+ *=============================================================================*/
+
+/* the master & the first NoOfWorkers workers run Trials dispatch runs on a communicator of their own */
+static void BenchDispatch (RefBenchConfigSt Config, int NoOfWorkers, int PrefetchDepth, const char * Name)
+{
+    int ProcRank, Trial;
+    MPI_Comm Comm;
+    double * Samples = new double [Config->Trials];
+
+    MPI_Comm_rank(MPI_COMM_WORLD, &ProcRank);
+    MPI_Comm_split (MPI_COMM_WORLD, (ProcRank <= NoOfWorkers) ? 0 : MPI_UNDEFINED, ProcRank, &Comm);
+
+    if (Comm != MPI_COMM_NULL) {
+        /* trial -1 is a warmup */
+        for (Trial = -1; Trial < Config->Trials; Trial++) {
+            MPI_Barrier (Comm);
+            if (ProcRank == MASTER_NODE) {
+                Samples[std::max (Trial, 0)] = Config->Chunks / BenchMaster (Comm, Config->Chunks, PrefetchDepth);
+            }else {
+                BenchSlave (Comm, PrefetchDepth);
+            }
+        }
+        MPI_Comm_free (&Comm);
+    }
+
+    if (ProcRank == MASTER_NODE) {
+        BenchReport (Name, (strcmp (Name, "prefetch") == 0) ? PrefetchDepth : NoOfWorkers,
+                Samples, Config->Trials, 1);
+        fflush (stdout);
+    }
+    delete[] Samples;
+    MPI_Barrier (MPI_COMM_WORLD);
+}
+
+/*==============================================================================
+ *  BenchMaster
+ *=============================================================================*/
+
+/*
+ * the loop of MasterWork without the integration : PrefetchDepth chunks per
+ * slave, then one chunk or quit per request, until all the slaves have exited.
+ * a send buffer is reused once its previous send has completed.
+ */
+static double BenchMaster (MPI_Comm Comm, long Chunks, int PrefetchDepth)
+{
+    int CommSize, Node, Slot, QuitCounter = 0;
+    long Dispatched = 0;
+    MPI_Status Status;
+    IndexSt Index[MAX_PROCESSORS][MAX_CHUNK];
+    MPI_Request SendReq[MAX_PROCESSORS][MAX_CHUNK];
+    int NextSlot[MAX_PROCESSORS] = {0};
+    std::chrono::time_point<std::chrono::steady_clock> StartTime;
+    std::chrono::duration<double> ElapsedTime;
+
+    MPI_Comm_size(Comm, &CommSize);
+    for (Node = 0; Node < CommSize; Node++) {
+        for (Slot = 0; Slot < MAX_CHUNK; Slot++) {
+            SendReq[Node][Slot] = MPI_REQUEST_NULL;
+        }
+    }
+
+    StartTime = std::chrono::steady_clock::now();
+    for (int i = 0; i < PrefetchDepth; i++) {
+        for (Node = 1; Node < CommSize; Node++) {
+            Index[Node][i].StartIndex = Dispatched * 100;
+            Index[Node][i].StopIndex = Index[Node][i].StartIndex + 100;
+            MPI_Isend (&Index[Node][i], 2, MPI_LONG, Node,
+                    (Dispatched < Chunks) ? MASTER_TO_SLAVE_WORK_AVAILABLE : MASTER_TO_SLAVE_QUIT,
+                    Comm, &SendReq[Node][i]);
+            Dispatched = std::min (Dispatched + 1, Chunks);
+        }
+    }
+    for (Node = 1; Node < CommSize; Node++) {
+        NextSlot[Node] = PrefetchDepth % MAX_CHUNK;
+    }
+
+    while (QuitCounter < CommSize - 1) {
+        MPI_Recv (NULL, 0, MPI_DOUBLE, MPI_ANY_SOURCE, MPI_ANY_TAG, Comm, &Status);
+        if (Status.MPI_TAG == SLAVE_TO_MASTER_EXITING) {
+            QuitCounter++;
+            continue;
+        }
+        Node = Status.MPI_SOURCE;
+        Slot = NextSlot[Node];
+        NextSlot[Node] = (Slot + 1) % MAX_CHUNK;
+        MPI_Wait (&SendReq[Node][Slot], MPI_STATUS_IGNORE);
+        Index[Node][Slot].StartIndex = Dispatched * 100;
+        Index[Node][Slot].StopIndex = Index[Node][Slot].StartIndex + 100;
+        MPI_Isend (&Index[Node][Slot], 2, MPI_LONG, Node,
+                (Dispatched < Chunks) ? MASTER_TO_SLAVE_WORK_AVAILABLE : MASTER_TO_SLAVE_QUIT,
+                Comm, &SendReq[Node][Slot]);
+        Dispatched = std::min (Dispatched + 1, Chunks);
+    }
+    ElapsedTime = std::chrono::steady_clock::now() - StartTime;
+
+    for (Node = 1; Node < CommSize; Node++) {
+        MPI_Waitall (MAX_CHUNK, SendReq[Node], MPI_STATUSES_IGNORE);
+    }
+
+    return ElapsedTime.count();
+}
+
+/*==============================================================================
+ *  BenchSlave
+ *=============================================================================*/
+
+/* the loop of SlaveWork with an empty kernel, the work requests carry no result */
+static void BenchSlave (MPI_Comm Comm, int PrefetchDepth)
+{
+    int QuitCounter = 0;
+    IndexSt Index;
+    MPI_Status Status;
+    MPI_Request SendReq = MPI_REQUEST_NULL;
+
+    while (1) {
+        MPI_Recv (&Index, 2, MPI_LONG, MASTER_NODE, MPI_ANY_TAG, Comm, &Status);
+        MPI_Wait (&SendReq, MPI_STATUS_IGNORE);
+        if (Status.MPI_TAG == MASTER_TO_SLAVE_WORK_AVAILABLE) {
+            MPI_Isend (NULL, 0, MPI_DOUBLE, MASTER_NODE, SLAVE_TO_MASTER_REQ_WORK, Comm, &SendReq);
+        }else if (++QuitCounter >= PrefetchDepth) {
+            MPI_Send (NULL, 0, MPI_DOUBLE, MASTER_NODE, SLAVE_TO_MASTER_EXITING, Comm);
+            break;
+        }
+    }
+}
+
+/*==============================================================================
+ *  BenchReport
+ *=============================================================================*/
+
+/* nearest rank percentiles, the samples are multiplied by Scale */
+static void BenchReport (const char * Name, int Param, double * Samples, int Count, double Scale)
+{
+    double Percentiles[3] = {0.5, 0.9, 0.99};
+    int i;
+
+    std::sort (Samples, Samples + Count);
+    printf ("%s %d %d", Name, Param, Count);
+    for (i = 0; i < 3; i++) {
+        printf (" %.6g", Samples[std::min (Count - 1, (int) (Percentiles[i] * Count))] * Scale);
+    }
+    printf (" %.6g %.6g\n", Samples[0] * Scale, Samples[Count - 1] * Scale);
+}
+
+/*==============================================================================
+ *  CreateIndexType
+ *=============================================================================*/
+
+static void CreateIndexType (MPI_Datatype * outType)
+{
+    /* create a single struct */
+    int NoOfBlocks = 2;               /* number of Blocks in the struct */
+    int Blocks[2] = {1, 1};   /* set up 2 Blocks */
+    MPI_Datatype Types[2] = {    /* index internal Types */
+        MPI_LONG,
+        MPI_LONG,
+    };
+    MPI_Aint Disp[2] = {          /* internal displacements */
+        offsetof(IndexSt, StartIndex),
+        offsetof(IndexSt, StopIndex),
+    };
+
+    MPI_Type_create_struct(NoOfBlocks, Blocks, Disp, Types, outType);
+    MPI_Type_commit(outType);
+}
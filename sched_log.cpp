@@ -0,0 +1,115 @@
+/*
+ * File Name       :sched_log.cpp
+ * Description     :Prints a decision log written by advnc_sched or
+ *                  dynamic_sched with --record
+ * Author          :Karthik Rao
+ * Version         :0.1
+ * To compile :
+ *
+ * g++ -std=c++11 -O2 sched_log.cpp -o sched_log
+ *
+ * Sample command line execution :
+ *
+ * ./sched_log result/sched.log
+ * ./sched_log result/sched.log --summary
+ *
+ * One line is printed per chunk handed out, in the order the master sent them :
+ *
+ * <Node> <StartIndex> <StopIndex> <first|backup> <DispatchTime> <CompletionTime>
+ *
+ * with the times in s from the start of the integration, -1 if the result of
+ * the chunk never came back (a cancelled backup copy). It is followed by one
+ * '#' line per slave with its no of chunks & points, its backup copies, the
+ * time its last result came back & the mean time from dispatch to completion
+ * of its chunks. --summary prints the '#' lines only.
+ */
+
+/* Debug prints will be enabled if set to 1 */
+#define DEBUG 0
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <string.h>
+#include <vector>
+
+#include "CommonHeader.h"
+#include "DecisionLog.h"
+
+typedef struct
+{
+    long NoOfChunks;
+    long NoOfPoints;
+    long NoOfBackups;
+    /* no of chunks whose result came back & sum of their dispatch to completion times */
+    long NoOfCompleted;
+    double TurnaroundSum;
+    double LastCompletion;
+
+} SlaveSummarySt;
+
+/*==============================================================================
+ *  main
+ *=============================================================================*/
+
+int main (int argc, char* argv[]) {
+
+    if (argc < 2 || (argc == 3 && strcmp (argv[2], "--summary") != 0) || argc > 3) {
+        std::cerr<<"Usage: "<<argv[0]<<" <LogFile> [--summary]"<<std::endl;
+
+        return -1;
+    }
+
+    DecisionLogSt Log;
+    DecisionRecordSt * Record;
+    bool SummaryOnly = (argc == 3);
+    double Makespan = 0;
+    long i;
+    int Node;
+
+    if (DecisionLogRead (&Log, argv[1]) != C_SUCCESS) {
+        DLOG(C_ERROR, "Unable to read the decision log %s\n", argv[1]);
+        return -1;
+    }
+
+    std::vector<SlaveSummarySt> Summary (Log.Header.CommSize);
+    memset (Summary.data(), 0, Summary.size() * sizeof(Summary[0]));
+
+    printf ("# nodes %d points %ld static %ld chunks %ld\n", Log.Header.CommSize,
+            (long) Log.Header.NoOfPoints, (long) Log.Header.StaticPoints, (long) Log.Header.NoOfRecords);
+
+    for (i = 0; i < Log.Header.NoOfRecords; i++) {
+        Record = &Log.Records[i];
+        if (!SummaryOnly) {
+            printf ("%d %ld %ld %s %.9f %.9f\n", Record->Node, (long) Record->StartIndex,
+                    (long) Record->StopIndex, (Record->Flags & DECISION_BACKUP_COPY) ? "backup" : "first",
+                    Record->DispatchTime, Record->CompletionTime);
+        }
+        if (Record->Node < 0 || Record->Node >= Log.Header.CommSize) {
+            continue;
+        }
+        SlaveSummarySt & Slave = Summary[Record->Node];
+        Slave.NoOfChunks++;
+        Slave.NoOfPoints += Record->StopIndex - Record->StartIndex;
+        Slave.NoOfBackups += (Record->Flags & DECISION_BACKUP_COPY) ? 1 : 0;
+        if (Record->CompletionTime >= 0) {
+            Slave.NoOfCompleted++;
+            Slave.TurnaroundSum += Record->CompletionTime - Record->DispatchTime;
+            Slave.LastCompletion = std::max (Slave.LastCompletion, Record->CompletionTime);
+            Makespan = std::max (Makespan, Record->CompletionTime);
+        }
+    }
+
+    /* the static blocks are not logged, the summary covers the chunks of the master only */
+    printf ("# node chunks points backups last_completion mean_turnaround\n");
+    for (Node = 1; Node < Log.Header.CommSize; Node++) {
+        printf ("# %d %ld %ld %ld %.9f %.9f\n", Node, Summary[Node].NoOfChunks, Summary[Node].NoOfPoints,
+                Summary[Node].NoOfBackups, Summary[Node].LastCompletion,
+                (Summary[Node].NoOfCompleted > 0) ? Summary[Node].TurnaroundSum / Summary[Node].NoOfCompleted : 0);
+    }
+    printf ("# last result %.9f\n", Makespan);
+
+    DecisionLogFree (&Log);
+
+    return 0;
+}
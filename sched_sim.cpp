@@ -0,0 +1,644 @@
+/*
+ * File Name       :sched_sim.cpp
+ * Description     :Discrete event simulator of the static, master-worker and
+ *                  advanced master-worker schedulers
+ * Author          :Karthik Rao
+ * Version         :0.1
+ * To compile :
+ *
+ * g++ -std=c++11 -O2 sched_sim.cpp -o sched_sim libfunctions.a
+ *
+ * Sample command line execution :
+ *
+ * ./sched_sim 1 0 10 1000000000 100 --ranks 2,4,8,16,32,64,128,256,512,1024
+ * ./sched_sim 6 0 10 1000000 100 --ranks 1024 --sched dynamic --granularity 1000
+ * ./sched_sim 8 0 10 100000000 10 --ranks 4096 --sched hybrid --static-fraction 0.9 --slow-rank 7:3
+ * ./sched_sim 1 0 10 1000000000 1 --ranks 64 --point-cost 4.2e-8 --latency 1.5e-6 --service 8e-7
+ *
+ * The simulator replays the messages of the real programs, it does not run
+ * MPI. The cost of the points is measured once on this machine : the range is
+ * split into SIM_COST_BINS bins & the integrands are timed on grid points of
+ * every bin, so the cost profile of the synthetic integrands is reproduced.
+ * --point-cost rescales the profile to the mean cost per point of the target
+ * machine, e.g. the compute phase of a short real run divided by its points.
+ *
+ * Every message takes --latency + bytes / --bandwidth to arrive, & the master
+ * spends --service on every message it handles or chunk it hands out. The
+ * master handles its messages one at a time in the order they arrive.
+ *
+ * static  : static_sched, P contiguous blocks, rank 0 included, the results are
+ *           received in rank order, followed by a barrier
+ * dynamic : dynamic_sched, one chunk per request, granularity 100
+ * advnc   : advnc_sched, DEFAULT_PREFETCH_DEPTH chunks prefetched per slave
+ * hybrid  : advnc_sched --sched hybrid, a static prefix followed by advnc
+ *
+ * For every no of ranks, one line is printed to stdout with the predicted run
+ * time, the speedup over a single process, the efficiency, the busy fraction
+ * of the master & the mean idle fraction of the workers.
+ */
+
+/* Debug prints will be enabled if set to 1 */
+#define DEBUG 0
+/* prefetch depth of advnc_sched */
+#define DEFAULT_PREFETCH_DEPTH 3
+/* max no of rank counts simulated in a single run */
+#define SIM_MAX_RANKS 64
+/* no of bins of the measured cost profile */
+#define SIM_COST_BINS 256
+/* min time spent measuring a bin, in s */
+#define SIM_BIN_TIME 1e-3
+/* max no of grid points of a bin which are timed */
+#define SIM_BIN_POINTS 1000
+/* bytes of an index message of dynamic_sched & advnc_sched */
+#define SIM_DYNAMIC_INDEX_BYTES 8
+#define SIM_ADVNC_INDEX_BYTES 16
+
+#define SIM_STATIC  0
+#define SIM_DYNAMIC 1
+#define SIM_ADVNC   2
+#define SIM_HYBRID  3
+
+/* default fraction of the range split statically by the hybrid scheduler */
+#define HYBRID_STATIC_FRACTION 0.8
+/* max fraction of the range split statically when it is derived from the speed of the slaves */
+#define HYBRID_MAX_FRACTION 0.95
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <chrono>
+#include <string.h>
+#include <cmath>
+#include <deque>
+#include <queue>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+#include "CommonHeader.h"
+#include "Integrand.h"
+
+/* events of the simulation */
+#define EVENT_MASTER_RECV   0
+#define EVENT_SLAVE_RECV    1
+#define EVENT_SLAVE_DONE    2
+
+/* messages of the simulated protocols */
+#define MSG_WORK            0
+#define MSG_QUIT            1
+#define MSG_REQ_WORK        2
+#define MSG_EXITING         3
+
+typedef struct
+{
+    double Time;
+    int Type;
+    int Node;
+    int Msg;
+    long StartIndex, StopIndex;
+    /* order of creation, breaks the ties between events at the same time */
+    long Seq;
+
+} SimEventSt;
+
+struct SimEventLater
+{
+    bool operator() (const SimEventSt & A, const SimEventSt & B) const
+    {
+        if (A.Time != B.Time) return A.Time > B.Time;
+        return A.Seq > B.Seq;
+    }
+};
+
+typedef struct
+{
+    int Msg;
+    long StartIndex, StopIndex;
+
+} SimMsgSt;
+
+typedef struct
+{
+    /* messages received & not yet handled, in arrival order */
+    std::deque<SimMsgSt> Inbox;
+    bool Busy;
+    /* the chunk being computed is the static block of the hybrid scheduler */
+    bool InStatic;
+    double ComputeTime;
+    double ComputeStart;
+    double FinishTime;
+    int QuitCounter;
+
+} SimSlaveSt;
+
+typedef struct
+{
+    int Sched;
+    long NoOfPoints;
+    long Granularity;
+    int PrefetchDepth;
+    /* -1 to derive it from the speed of the slaves */
+    double StaticFraction;
+    double Latency, Bandwidth, Service;
+    /* coefficient of variation of the cost of a chunk, 0 for none */
+    double Jitter;
+    int NoOfIntegrands;
+    /* cost of the points [0, i * NoOfPoints / SIM_COST_BINS), SIM_COST_BINS + 1 values */
+    double CumCost[SIM_COST_BINS + 1];
+    /* slowed down ranks */
+    std::vector<int> SlowRanks;
+    std::vector<double> SlowFactors;
+
+} SimConfigSt;
+/* Reference to simulator configuration structure */
+typedef SimConfigSt * RefSimConfigSt;
+
+typedef struct
+{
+    double RunTime;
+    /* fraction of the run time the master spends handling messages */
+    double MasterBusy;
+    /* mean fraction of the run time the workers do not compute */
+    double WorkerIdle;
+
+} SimResultSt;
+
+/* function to measure the cost profile of the integrands on this machine */
+static void SimMeasureCost (RefSimConfigSt Config, IntegrandSt * Integrands, double LowerBound,
+        double UpperBound, double PointCost);
+/* function to get the cost of the points [StartIndex, StopIndex) */
+static double SimCost (RefSimConfigSt Config, long StartIndex, long StopIndex);
+/* function to get the work multiplier of a rank */
+static double SimSlowdown (RefSimConfigSt Config, int Rank);
+/* function to simulate static_sched on CommSize ranks */
+static void SimStatic (RefSimConfigSt Config, int CommSize, SimResultSt * outResult);
+/* function to simulate the master-worker schedulers on CommSize ranks */
+static void SimMasterWorker (RefSimConfigSt Config, int CommSize, SimResultSt * outResult);
+
+/*==============================================================================
+ *  main
+ *=============================================================================*/
+
+int main (int argc, char* argv[]) {
+
+    if (argc < 6) {
+        std::cerr<<"Usage: "<<argv[0]<<" <FunctionID> <LowerBound> <UpperBound> \
+            <NoOfPoints> <Intensity> --ranks <P>[,<P>...] [--sched static|dynamic|advnc|hybrid] \
+            [--granularity <Points>] [--prefetch <Chunks>] [--static-fraction <F>|auto] \
+            [--point-cost <s>] [--latency <s>] [--bandwidth <Bytes/s>] [--service <s>] \
+            [--jitter <CV>] [--slow-rank <Rank>:<Factor>]"<<std::endl;
+
+        return -1;
+    }
+
+    static SimConfigSt Config;
+    IntegrandSt Integrands[MAX_INTEGRANDS];
+    SimResultSt Result;
+    int Ranks[SIM_MAX_RANKS];
+    int NoOfRanks = 0, i;
+    double LowerBound, UpperBound, SerialTime, PointCost = 0, Factor;
+    const char * Sched = "advnc";
+    long Granularity = 0;
+    int PrefetchDepth = 0;
+    char * End;
+
+    Config.StaticFraction = HYBRID_STATIC_FRACTION;
+    /* a small cluster interconnect, to be replaced with measured values */
+    Config.Latency = 2e-6;
+    Config.Bandwidth = 5e9;
+    Config.Service = 1e-6;
+    Config.Jitter = 0;
+
+    for (int Arg = 6; Arg < argc; Arg++) {
+        if (strcmp (argv[Arg], "--ranks") == 0 && Arg + 1 < argc) {
+            NoOfRanks = ParseIntList (argv[++Arg], Ranks, SIM_MAX_RANKS);
+        }else if (strcmp (argv[Arg], "--sched") == 0 && Arg + 1 < argc) {
+            Sched = argv[++Arg];
+        }else if (strcmp (argv[Arg], "--granularity") == 0 && Arg + 1 < argc) {
+            Granularity = atol (argv[++Arg]);
+        }else if (strcmp (argv[Arg], "--prefetch") == 0 && Arg + 1 < argc) {
+            PrefetchDepth = atoi (argv[++Arg]);
+        }else if (strcmp (argv[Arg], "--static-fraction") == 0 && Arg + 1 < argc) {
+            Arg++;
+            Config.StaticFraction = (strcmp (argv[Arg], "auto") == 0) ? -1 : atof (argv[Arg]);
+        }else if (strcmp (argv[Arg], "--point-cost") == 0 && Arg + 1 < argc) {
+            PointCost = atof (argv[++Arg]);
+        }else if (strcmp (argv[Arg], "--latency") == 0 && Arg + 1 < argc) {
+            Config.Latency = atof (argv[++Arg]);
+        }else if (strcmp (argv[Arg], "--bandwidth") == 0 && Arg + 1 < argc) {
+            Config.Bandwidth = atof (argv[++Arg]);
+        }else if (strcmp (argv[Arg], "--service") == 0 && Arg + 1 < argc) {
+            Config.Service = atof (argv[++Arg]);
+        }else if (strcmp (argv[Arg], "--jitter") == 0 && Arg + 1 < argc) {
+            Config.Jitter = atof (argv[++Arg]);
+        }else if (strcmp (argv[Arg], "--slow-rank") == 0 && Arg + 1 < argc) {
+            Arg++;
+            i = (int) strtol (argv[Arg], &End, 10);
+            Factor = (*End == ':') ? strtod (End + 1, &End) : 0;
+            if (*End != '\0' || Factor < 1) {
+                DLOG(C_ERROR, "Invalid slowdown %s\n", argv[Arg]);
+                return -1;
+            }
+            Config.SlowRanks.push_back (i);
+            Config.SlowFactors.push_back (Factor);
+        }else {
+            DLOG(C_ERROR, "Invalid option %s\n", argv[Arg]);
+            return -1;
+        }
+    }
+
+    LowerBound = atof (argv[2]);
+    UpperBound = atof (argv[3]);
+    Config.NoOfPoints = atol (argv[4]);
+
+    if (ParseIntegrands (argv[1], argv[5], Integrands, &Config.NoOfIntegrands) != C_SUCCESS) {
+        DLOG(C_ERROR, "Invalid function input for integration\n");
+        return -1;
+    }
+    if (NoOfRanks <= 0) {
+        DLOG(C_ERROR, "Invalid no of ranks, --ranks is mandatory\n");
+        return -1;
+    }
+    for (i = 0; i < NoOfRanks; i++) {
+        if (Ranks[i] < 2) {
+            DLOG(C_ERROR, "Invalid no of ranks %d, at least 2 are needed\n", Ranks[i]);
+            return -1;
+        }
+    }
+    if (Config.NoOfPoints < SIM_COST_BINS || Config.Latency < 0 || Config.Bandwidth <= 0 ||
+            Config.Service < 0 || Config.Jitter < 0 || PointCost < 0) {
+        DLOG(C_ERROR, "Invalid simulation parameters\n");
+        return -1;
+    }
+    if (Config.StaticFraction != -1 && (Config.StaticFraction < 0 || Config.StaticFraction > 1)) {
+        DLOG(C_ERROR, "Invalid static fraction\n");
+        return -1;
+    }
+
+    /* the defaults of the real programs */
+    if (strcmp (Sched, "static") == 0) {
+        Config.Sched = SIM_STATIC;
+    }else if (strcmp (Sched, "dynamic") == 0) {
+        Config.Sched = SIM_DYNAMIC;
+        Config.Granularity = 100;
+        Config.PrefetchDepth = 1;
+    }else if (strcmp (Sched, "advnc") == 0 || strcmp (Sched, "hybrid") == 0) {
+        Config.Sched = (strcmp (Sched, "advnc") == 0) ? SIM_ADVNC : SIM_HYBRID;
+        Config.Granularity = (Config.NoOfPoints < 10000) ? 10 : 100;
+        Config.PrefetchDepth = DEFAULT_PREFETCH_DEPTH;
+    }else {
+        DLOG(C_ERROR, "Invalid scheduler %s\n", Sched);
+        return -1;
+    }
+    if (Config.Sched != SIM_HYBRID) {
+        Config.StaticFraction = 0;
+    }
+    if (Granularity > 0) {
+        Config.Granularity = Granularity;
+    }
+    if (PrefetchDepth > 0 && Config.Sched != SIM_DYNAMIC) {
+        Config.PrefetchDepth = PrefetchDepth;
+    }
+
+    SimMeasureCost (&Config, Integrands, LowerBound, UpperBound, PointCost);
+    SerialTime = Config.CumCost[SIM_COST_BINS];
+
+    std::cout<<"# "<<Sched<<" scheduler, "<<Config.NoOfPoints<<" points, "
+        <<SerialTime / Config.NoOfPoints<<" s per point, serial time "<<SerialTime<<" s"<<std::endl;
+    std::cout<<"# ranks runtime speedup efficiency master_busy worker_idle"<<std::endl;
+
+    for (i = 0; i < NoOfRanks; i++) {
+        if (Config.Sched == SIM_STATIC) {
+            SimStatic (&Config, Ranks[i], &Result);
+        }else {
+            SimMasterWorker (&Config, Ranks[i], &Result);
+        }
+        std::cout<<Ranks[i]<<" "<<Result.RunTime<<" "<<SerialTime / Result.RunTime<<" "
+            <<SerialTime / Result.RunTime / Ranks[i]<<" "<<Result.MasterBusy<<" "<<Result.WorkerIdle<<std::endl;
+    }
+
+    return 0;
+}
+
+/*==============================================================================
+ *  SimMeasureCost
+ *=============================================================================*/
+
+/*
+ * time up to SIM_BIN_POINTS grid points of every bin, spread over the bin, for
+ * at least SIM_BIN_TIME. the cost of a point is then taken as the mean of its
+ * bin. a non zero PointCost rescales the profile to that mean cost per point.
+ */
+static void SimMeasureCost (RefSimConfigSt Config, IntegrandSt * Integrands, double LowerBound,
+        double UpperBound, double PointCost)
+{
+    long Bin, BinStart, BinStop, Stride, i, NoOfTimed, Rounds;
+    int k;
+    double y, x, BinCost, Elapsed, Scale;
+    /* keeps the integrands from being optimized away */
+    volatile double Sink = 0;
+    std::chrono::steady_clock::time_point Start;
+
+    SynthConfigure (LowerBound, UpperBound, 1);
+    y = (UpperBound - LowerBound) / Config->NoOfPoints;
+
+    Config->CumCost[0] = 0;
+    for (Bin = 0; Bin < SIM_COST_BINS; Bin++) {
+        BinStart = Bin * Config->NoOfPoints / SIM_COST_BINS;
+        BinStop = (Bin + 1) * Config->NoOfPoints / SIM_COST_BINS;
+        Stride = std::max (1L, (BinStop - BinStart) / SIM_BIN_POINTS);
+
+        Rounds = 0;
+        NoOfTimed = 0;
+        Start = std::chrono::steady_clock::now();
+        do {
+            for (i = BinStart; i < BinStop; i += Stride) {
+                x = LowerBound + (i + 0.5) * y;
+                for (k = 0; k < Config->NoOfIntegrands; k++) {
+                    Sink = Sink + Integrands[k].FuncToIntegrate (x, Integrands[k].Intensity);
+                }
+                NoOfTimed++;
+            }
+            Rounds++;
+            Elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+        } while (Elapsed < SIM_BIN_TIME);
+
+        BinCost = Elapsed / NoOfTimed;
+        Config->CumCost[Bin + 1] = Config->CumCost[Bin] + BinCost * (BinStop - BinStart);
+        DLOG (C_VERBOSE, "bin %ld : %ld points timed %ld times, %g s per point\n", Bin,
+                NoOfTimed / Rounds, Rounds, BinCost);
+    }
+
+    if (PointCost > 0) {
+        Scale = PointCost * Config->NoOfPoints / Config->CumCost[SIM_COST_BINS];
+        for (Bin = 0; Bin <= SIM_COST_BINS; Bin++) {
+            Config->CumCost[Bin] *= Scale;
+        }
+    }
+}
+
+/*==============================================================================
+ *  SimCost
+ *=============================================================================*/
+
+/* cost of the points before Index, interpolated within a bin */
+static double SimCumCost (RefSimConfigSt Config, long Index)
+{
+    long Bin = Index * SIM_COST_BINS / Config->NoOfPoints;
+    long BinStart, BinStop;
+
+    if (Bin >= SIM_COST_BINS) {
+        return Config->CumCost[SIM_COST_BINS];
+    }
+    /* the bins are not all of the same size if SIM_COST_BINS does not divide NoOfPoints */
+    while (Bin > 0 && Index < Bin * Config->NoOfPoints / SIM_COST_BINS) {
+        Bin--;
+    }
+    while (Index >= (Bin + 1) * Config->NoOfPoints / SIM_COST_BINS) {
+        Bin++;
+    }
+    BinStart = Bin * Config->NoOfPoints / SIM_COST_BINS;
+    BinStop = (Bin + 1) * Config->NoOfPoints / SIM_COST_BINS;
+
+    return Config->CumCost[Bin] + (Config->CumCost[Bin + 1] - Config->CumCost[Bin]) *
+        (double) (Index - BinStart) / (double) (BinStop - BinStart);
+}
+
+static double SimCost (RefSimConfigSt Config, long StartIndex, long StopIndex)
+{
+    return SimCumCost (Config, StopIndex) - SimCumCost (Config, StartIndex);
+}
+
+/*==============================================================================
+ *  SimSlowdown
+ *=============================================================================*/
+
+static double SimSlowdown (RefSimConfigSt Config, int Rank)
+{
+    double Slowdown = 1;
+
+    /* like --slow-rank of the real programs, the last one given for a rank wins */
+    for (size_t i = 0; i < Config->SlowRanks.size(); i++) {
+        if (Config->SlowRanks[i] == Rank) {
+            Slowdown = Config->SlowFactors[i];
+        }
+    }
+    return Slowdown;
+}
+
+/*==============================================================================
+ *  SimMsgTime
+ *=============================================================================*/
+
+static double SimMsgTime (RefSimConfigSt Config, long Bytes)
+{
+    return Config->Latency + Bytes / Config->Bandwidth;
+}
+
+/*==============================================================================
+ *  SimStatic
+ *=============================================================================*/
+
+/*
+ * static_sched : every rank computes its block, rank 0 then receives the
+ * results in rank order & all the ranks leave a barrier.
+ */
+static void SimStatic (RefSimConfigSt Config, int CommSize, SimResultSt * outResult)
+{
+    double Finish, MasterTime = 0, ComputeTime = 0, Cost;
+    long StartIndex, StopIndex;
+    int Rank;
+
+    for (Rank = 0; Rank < CommSize; Rank++) {
+        StartIndex = (long) floor ((double) Rank * Config->NoOfPoints / CommSize);
+        StopIndex = (long) floor ((double) (Rank + 1) * Config->NoOfPoints / CommSize);
+        Cost = SimCost (Config, StartIndex, StopIndex) * SimSlowdown (Config, Rank);
+        ComputeTime += Cost;
+
+        if (Rank == 0) {
+            MasterTime = Cost;
+        }else {
+            Finish = Cost + SimMsgTime (Config, Config->NoOfIntegrands * sizeof(float));
+            MasterTime = std::max (MasterTime, Finish) + Config->Service;
+        }
+    }
+
+    /* dissemination barrier */
+    outResult->RunTime = MasterTime + 2 * ceil (log2 ((double) CommSize)) * SimMsgTime (Config, 0);
+    outResult->MasterBusy = (CommSize - 1) * Config->Service / outResult->RunTime;
+    outResult->WorkerIdle = 1 - ComputeTime / CommSize / outResult->RunTime;
+}
+
+/*==============================================================================
+ *  SimMasterWorker
+ *=============================================================================*/
+
+/*
+ * dynamic_sched, advnc_sched & its hybrid scheduler. the slaves handle their
+ * messages in arrival order : a chunk is computed, then reported with an empty
+ * work request. a slave leaves after PrefetchDepth quits (advnc_sched sends one
+ * per prefetch slot & waits for the exit messages, dynamic_sched does not), and
+ * the sums are combined with MPI_Reduce.
+ */
+static void SimMasterWorker (RefSimConfigSt Config, int CommSize, SimResultSt * outResult)
+{
+    std::priority_queue<SimEventSt, std::vector<SimEventSt>, SimEventLater> Events;
+    std::vector<SimSlaveSt> Slaves (CommSize);
+    std::mt19937 Rng (1);
+    double Sigma = sqrt (log (1 + Config->Jitter * Config->Jitter));
+    std::lognormal_distribution<double> Noise (-Sigma * Sigma / 2, Sigma);
+    long IndexBytes = (Config->Sched == SIM_DYNAMIC) ? SIM_DYNAMIC_INDEX_BYTES : SIM_ADVNC_INDEX_BYTES;
+    double IndexTime = SimMsgTime (Config, IndexBytes);
+    double EmptyTime = SimMsgTime (Config, 0);
+    long CompletedIndex, StaticPoints, BlockSize, Seq = 0;
+    double MasterFree = 0, MasterBusy = 0, MasterDone = 0, End = 0, ComputeTime = 0;
+    double Fraction, MinSpeed, MeanSpeed, Start, Cost;
+    int QuitCounter = 0, Node, Slot;
+    SimEventSt Event;
+    SimMsgSt Msg;
+
+    /* the auto fraction of the hybrid scheduler, without the noise of a probe chunk */
+    Fraction = Config->StaticFraction;
+    if (Fraction == -1) {
+        MinSpeed = 1 / SimSlowdown (Config, 1);
+        MeanSpeed = 0;
+        for (Node = 1; Node < CommSize; Node++) {
+            MinSpeed = std::min (MinSpeed, 1 / SimSlowdown (Config, Node));
+            MeanSpeed += 1 / SimSlowdown (Config, Node) / (CommSize - 1);
+        }
+        Fraction = std::min (HYBRID_MAX_FRACTION, MinSpeed / MeanSpeed);
+    }
+    StaticPoints = (long) (Fraction * Config->NoOfPoints);
+    CompletedIndex = StaticPoints;
+
+    /* queue an event, lambdas keep the protocol below readable */
+    auto Post = [&](double Time, int Type, int To, int Kind, long StartIndex, long StopIndex) {
+        SimEventSt New = {Time, Type, To, Kind, StartIndex, StopIndex, Seq++};
+        Events.push (New);
+    };
+    auto Compute = [&](int To, double Time, long StartIndex, long StopIndex) {
+        Cost = SimCost (Config, StartIndex, StopIndex) * SimSlowdown (Config, To);
+        if (Config->Jitter > 0) {
+            Cost *= Noise (Rng);
+        }
+        Slaves[To].Busy = true;
+        Slaves[To].ComputeStart = Time;
+        Post (Time + Cost, EVENT_SLAVE_DONE, To, MSG_WORK, StartIndex, StopIndex);
+    };
+    /* the master hands out the next chunk or a quit, once it is free */
+    auto Reply = [&](int To, double Time) {
+        if (CompletedIndex < Config->NoOfPoints) {
+            long StopIndex = std::min (CompletedIndex + Config->Granularity, Config->NoOfPoints);
+            Post (Time + IndexTime, EVENT_SLAVE_RECV, To, MSG_WORK, CompletedIndex, StopIndex);
+            CompletedIndex = StopIndex;
+        }else {
+            Post (Time + IndexTime, EVENT_SLAVE_RECV, To, MSG_QUIT, 0, 0);
+            if (Config->Sched == SIM_DYNAMIC && ++QuitCounter == CommSize - 1) {
+                MasterDone = Time;
+            }
+        }
+    };
+
+    /* an idle slave takes the messages queued for it in order, until it has a chunk to compute */
+    auto Drain = [&](int To, double Time) {
+        SimMsgSt Next;
+        while (!Slaves[To].Busy && !Slaves[To].Inbox.empty()) {
+            Next = Slaves[To].Inbox.front();
+            Slaves[To].Inbox.pop_front();
+            if (Next.Msg == MSG_WORK) {
+                Compute (To, Time, Next.StartIndex, Next.StopIndex);
+            }else if (++Slaves[To].QuitCounter == Config->PrefetchDepth) {
+                Slaves[To].FinishTime = Time;
+                if (Config->Sched != SIM_DYNAMIC) {
+                    Post (Time + EmptyTime, EVENT_MASTER_RECV, To, MSG_EXITING, 0, 0);
+                }
+            }
+        }
+    };
+
+    for (Node = 1; Node < CommSize; Node++) {
+        Slaves[Node].Busy = false;
+        Slaves[Node].InStatic = false;
+        Slaves[Node].ComputeTime = 0;
+        Slaves[Node].FinishTime = 0;
+        Slaves[Node].QuitCounter = 0;
+    }
+
+    if (Config->Sched == SIM_DYNAMIC) {
+        /* the first request of every slave carries no result */
+        for (Node = 1; Node < CommSize; Node++) {
+            Post (EmptyTime, EVENT_MASTER_RECV, Node, MSG_REQ_WORK, 0, 0);
+        }
+    }else {
+        if (StaticPoints > 0) {
+            BlockSize = (StaticPoints + CommSize - 2) / (CommSize - 1);
+            for (Node = 1; Node < CommSize; Node++) {
+                Slaves[Node].InStatic = true;
+                Compute (Node, 0, std::min ((Node - 1) * BlockSize, StaticPoints),
+                        std::min (Node * BlockSize, StaticPoints));
+            }
+        }
+        /* PrefetchDepth rounds of chunks (or quits for the empty slots) in round robin order */
+        for (Slot = 0; Slot < Config->PrefetchDepth; Slot++) {
+            for (Node = 1; Node < CommSize; Node++) {
+                MasterFree += Config->Service;
+                MasterBusy += Config->Service;
+                Reply (Node, MasterFree);
+            }
+        }
+    }
+
+    while (!Events.empty()) {
+
+        Event = Events.top();
+        Events.pop();
+        Node = Event.Node;
+
+        switch (Event.Type) {
+
+            case EVENT_MASTER_RECV:
+                Start = std::max (Event.Time, MasterFree);
+                MasterFree = Start + Config->Service;
+                MasterBusy += Config->Service;
+                if (Event.Msg == MSG_EXITING) {
+                    if (++QuitCounter == CommSize - 1) {
+                        MasterDone = MasterFree;
+                    }
+                }else {
+                    Reply (Node, MasterFree);
+                }
+                break;
+
+            case EVENT_SLAVE_DONE:
+                Slaves[Node].Busy = false;
+                Slaves[Node].ComputeTime += Event.Time - Slaves[Node].ComputeStart;
+                if (Slaves[Node].InStatic) {
+                    Slaves[Node].InStatic = false;
+                }else {
+                    Post (Event.Time + EmptyTime, EVENT_MASTER_RECV, Node, MSG_REQ_WORK, 0, 0);
+                }
+                Drain (Node, Event.Time);
+                break;
+
+            case EVENT_SLAVE_RECV:
+                Msg.Msg = Event.Msg;
+                Msg.StartIndex = Event.StartIndex;
+                Msg.StopIndex = Event.StopIndex;
+                Slaves[Node].Inbox.push_back (Msg);
+                Drain (Node, Event.Time);
+                break;
+        }
+    }
+
+    End = MasterDone;
+    for (Node = 1; Node < CommSize; Node++) {
+        End = std::max (End, Slaves[Node].FinishTime);
+        ComputeTime += Slaves[Node].ComputeTime;
+    }
+    /* binomial tree reduce of the local sums */
+    End += ceil (log2 ((double) CommSize)) * SimMsgTime (Config, Config->NoOfIntegrands * sizeof(double));
+
+    outResult->RunTime = End;
+    outResult->MasterBusy = MasterBusy / End;
+    outResult->WorkerIdle = 1 - ComputeTime / (CommSize - 1) / End;
+}
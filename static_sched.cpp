@@ -8,6 +8,10 @@
  * Sample command line execution :
  * 
  * mpirun -n 3 ./static_sched  1 0 10 1000 1
+ * mpirun -n 3 ./static_sched  1,2,3,4 0 10 1000 1
+ * mpirun -n 3 ./static_sched  1 0 10 1000 1 --repeat 10 --warmup 2
+ * mpirun -n 3 ./static_sched  6 0 10 1000 100 --slow-rank 1:4
+ * mpirun -n 3 ./static_sched  1 0 10 1000 1 --affinity scatter
  * qsub -d $(pwd) -q mamba -l procs=2 -v FID=1,A=0,B=10,N=1000,INTENSITY=1,PROC=2 ./run_static.sh
  *
  */
@@ -28,22 +32,10 @@
 #include <cmath>
 
 #include "CommonHeader.h"
+#include "Integrand.h"
+#include "PhaseTimer.h"
+#include "Affinity.h"
 
-#ifdef __cplusplus
-extern "C" {
-#endif
-
-    float f1(float x, int intensity);
-    float f2(float x, int intensity);
-    float f3(float x, int intensity);
-    float f4(float x, int intensity);
-
-#ifdef __cplusplus
-}
-#endif
-
-/* function pointer to one of the following functions : f1, f2, f3, f4 */
-typedef float (*Func) (float, int);
 
 
 /*==============================================================================
@@ -55,14 +47,19 @@ int main (int argc, char* argv[]) {
 
     if (argc < 6) {
         std::cerr<<"Usage: "<<argv[0]<<" <FunctionID> <LowerBound> <UpperBound> \
-            <NoOfPoints> <Intensity> "<<std::endl;
+            <NoOfPoints> <Intensity> [--repeat <Trials>] [--warmup <Trials>] \
+            [--slow-rank <Rank>:<Factor>] [--affinity compact|scatter|master]"<<std::endl;
 
         return -1;
     }
 
     MPI_Init(NULL, NULL);
 
-    int i, FunctionID, Intensity, Node;
+    int i, k, Node, Trial;
+    /* slowdown of this node, every integrand is stretched by it (--slow-rank) */
+    double Slowdown = 1;
+    /* placement of the nodes on the cores */
+    int AffinityLayout = AFFINITY_NONE;
     float LowerBound, UpperBound;
     int NoOfPoints;
     float  x, y, FunOutput;
@@ -73,99 +70,164 @@ int main (int argc, char* argv[]) {
     float * IntegralOutput;
     float * NodeIntegralOutput;
 
-    IntegralOutput = new float [1];
-    NodeIntegralOutput = new float [1];
-    memset (IntegralOutput, 0, sizeof(IntegralOutput[0]));
-    memset (NodeIntegralOutput, 0, sizeof(NodeIntegralOutput[0]));
-
-    /* function pointer to one of the following functions : f1, f2, f3, f4 */
-    Func FuncToIntegrate;
+    /* integrands computed in a single pass over the grid */
+    IntegrandSt Integrands[MAX_INTEGRANDS];
+    int NoOfIntegrands = 0;
 
     /* measure time taken for integration */
-    std::chrono::time_point<std::chrono::system_clock> StartTime;
-    std::chrono::time_point<std::chrono::system_clock>  EndTime;
+    std::chrono::time_point<std::chrono::steady_clock> StartTime;
+    std::chrono::time_point<std::chrono::steady_clock>  EndTime;
     std::chrono::duration<double> ElapsedTime;
+    /* start of the block of this node, stretched by --slow-rank */
+    std::chrono::steady_clock::time_point BlockStart;
+
+    /* the integration is repeated NoOfTrials times after NoOfWarmups unrecorded runs */
+    int NoOfTrials = 1, NoOfWarmups = 0;
+    double TrialTimes[MAX_TRIALS];
+    PhaseTimerSt Timer;
+    Timer.NoOfTrials = 0;
+
+    MPI_Comm_size(MPI_COMM_WORLD, &CommSize);
+    MPI_Comm_rank(MPI_COMM_WORLD, &ProcRank);
+
+    for (int Arg = 6; Arg < argc; Arg++) {
+        if (strcmp (argv[Arg], "--repeat") == 0 && Arg + 1 < argc) {
+            NoOfTrials = atoi (argv[++Arg]);
+        }else if (strcmp (argv[Arg], "--warmup") == 0 && Arg + 1 < argc) {
+            NoOfWarmups = atoi (argv[++Arg]);
+        }else if (strcmp (argv[Arg], "--affinity") == 0 && Arg + 1 < argc) {
+            if (AffinityParse (argv[++Arg], &AffinityLayout) != C_SUCCESS) {
+                DLOG(C_ERROR, "Invalid affinity layout %s\n", argv[Arg]);
+                goto EXIT;
+            }
+        }else if (strcmp (argv[Arg], "--slow-rank") == 0 && Arg + 1 < argc) {
+            if (SynthParseSlowdown (argv[++Arg], ProcRank, &Slowdown) != C_SUCCESS) {
+                DLOG(C_ERROR, "Invalid slowdown %s\n", argv[Arg]);
+                goto EXIT;
+            }
+        }else {
+            DLOG(C_ERROR, "Invalid option %s\n", argv[Arg]);
+            goto EXIT;
+        }
+    }
+    if (NoOfTrials < 1 || NoOfTrials > MAX_TRIALS || NoOfWarmups < 0) {
+        DLOG(C_ERROR, "Invalid no of trials\n");
+        goto EXIT;
+    }
 
-    FunctionID  = atoi (argv[1]);
     LowerBound  = atof (argv[2]);
     UpperBound  = atof (argv[3]);
     NoOfPoints  = atoi (argv[4]);
-    Intensity   = atoi (argv[5]);
 
-    DLOG (C_VERBOSE, "The FunctionID = %d\n", FunctionID);
     DLOG (C_VERBOSE, "The LowerBound = %f\n", LowerBound);
     DLOG (C_VERBOSE, "The UpperBound = %f\n", UpperBound);
     DLOG (C_VERBOSE, "The NoOfPoints = %d\n", NoOfPoints);
-    DLOG (C_VERBOSE, "The Intensity = %d\n", Intensity);
-
-    /* based on the input argument, select suitable function to integrate */
-    switch (FunctionID)
-    {
-        case 1:FuncToIntegrate = f1;
-               break;
-        case 2:FuncToIntegrate = f2;
-               break;
-        case 3:FuncToIntegrate = f3;
-               break;
-        case 4:FuncToIntegrate = f4;
-               break;
-        default:
-               DLOG(C_ERROR, "Invalid function input for integration\n");
-               goto EXIT;
-    }
 
-    MPI_Comm_size(MPI_COMM_WORLD, &CommSize);
-    MPI_Comm_rank(MPI_COMM_WORLD, &ProcRank);
-    StartIndex = (int)floor ((ProcRank) * NoOfPoints/CommSize);
-    StopIndex  = (int)floor ((ProcRank+1) * NoOfPoints/CommSize);
-    /*  y = (a - b)/n */
-    y = (UpperBound - LowerBound)/NoOfPoints;
+    /* based on the input argument, select suitable functions to integrate */
+    if (ParseIntegrands (argv[1], argv[5], Integrands, &NoOfIntegrands) != C_SUCCESS) {
+        DLOG(C_ERROR, "Invalid function input for integration\n");
+        goto EXIT;
+    }
+    DLOG (C_VERBOSE, "The NoOfIntegrands = %d\n", NoOfIntegrands);
 
-    DLOG (C_VERBOSE, "rank %d out of %d processors. \n", ProcRank, CommSize);
-    DLOG (C_VERBOSE, "node[%d] The StartIndex = %f\n", ProcRank, StartIndex);
-    DLOG (C_VERBOSE, "node[%d] The StopIndex = %f\n", ProcRank, StopIndex);
+    SynthConfigure (LowerBound, UpperBound, Slowdown);
 
-    MPI_Barrier( MPI_COMM_WORLD ) ;
-    if (ProcRank == NODE_0){
-        StartTime = std::chrono::system_clock::now();
+    /* pin the node before any buffer is allocated, so that the buffers are first touched on its core */
+    if (AffinityLayout != AFFINITY_NONE) {
+        AffinityBind (AffinityLayout, MPI_COMM_WORLD, NODE_0);
+        AffinityReport (MPI_COMM_WORLD, NODE_0, stdout);
     }
-    MPI_Barrier( MPI_COMM_WORLD ) ;
 
+    for (Trial = 0; Trial < NoOfWarmups + NoOfTrials; Trial++) {
 
-    for (i= StartIndex; i< StopIndex; i++) {
+        PhaseTimerBeginTrial (&Timer);
 
-        x = (LowerBound + ((i + 0.5)*y));
-        FunOutput = FuncToIntegrate (x, Intensity);
-        FunOutput = FunOutput * y ;
-        IntegralOutput[0] = IntegralOutput[0] + FunOutput;
+        MPI_Barrier( MPI_COMM_WORLD ) ;
+        if (ProcRank == NODE_0){
+            StartTime = std::chrono::steady_clock::now();
+        }
+        MPI_Barrier( MPI_COMM_WORLD ) ;
+
+        PhaseTimerSwitch (&Timer, PHASE_SETUP);
+
+        IntegralOutput = new float [NoOfIntegrands];
+        NodeIntegralOutput = new float [NoOfIntegrands];
+        memset (IntegralOutput, 0, NoOfIntegrands * sizeof(IntegralOutput[0]));
+        memset (NodeIntegralOutput, 0, NoOfIntegrands * sizeof(NodeIntegralOutput[0]));
+
+        StartIndex = (int)floor ((ProcRank) * NoOfPoints/CommSize);
+        StopIndex  = (int)floor ((ProcRank+1) * NoOfPoints/CommSize);
+        /*  y = (a - b)/n */
+        y = (UpperBound - LowerBound)/NoOfPoints;
+
+        DLOG (C_VERBOSE, "rank %d out of %d processors. \n", ProcRank, CommSize);
+        DLOG (C_VERBOSE, "node[%d] The StartIndex = %f\n", ProcRank, StartIndex);
+        DLOG (C_VERBOSE, "node[%d] The StopIndex = %f\n", ProcRank, StopIndex);
+
+        PhaseTimerSwitch (&Timer, PHASE_COMPUTE);
+        BlockStart = std::chrono::steady_clock::now();
+
+        for (i= StartIndex; i< StopIndex; i++) {
+
+            x = (LowerBound + ((i + 0.5)*y));
+            for (k = 0; k < NoOfIntegrands; k++) {
+                FunOutput = Integrands[k].FuncToIntegrate (x, Integrands[k].Intensity);
+                FunOutput = FunOutput * y ;
+                IntegralOutput[k] = IntegralOutput[k] + FunOutput;
+            }
 
-    }
-    if (ProcRank != NODE_0){
-        DLOG (C_VERBOSE, "node[%d] The IntegralOutput = %f\n", ProcRank,IntegralOutput[0]);
-        MPI_Send (IntegralOutput, 1, MPI_FLOAT, NODE_0, 0, MPI_COMM_WORLD);
-    }else{
-
-        for (Node=1; Node<CommSize; Node++)
-        {
-            MPI_Recv (NodeIntegralOutput, 1, MPI_FLOAT, Node, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE );
-            IntegralOutput[0] = IntegralOutput[0] + NodeIntegralOutput[0];
         }
+        SynthStretch (BlockStart);
+
+        PhaseTimerSwitch (&Timer, PHASE_REDUCTION);
+
+        if (ProcRank != NODE_0){
+            DLOG (C_VERBOSE, "node[%d] The IntegralOutput = %f\n", ProcRank,IntegralOutput[0]);
+            MPI_Send (IntegralOutput, NoOfIntegrands, MPI_FLOAT, NODE_0, 0, MPI_COMM_WORLD);
+        }else{
+
+            for (Node=1; Node<CommSize; Node++)
+            {
+                MPI_Recv (NodeIntegralOutput, NoOfIntegrands, MPI_FLOAT, Node, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE );
+                for (k = 0; k < NoOfIntegrands; k++) {
+                    IntegralOutput[k] = IntegralOutput[k] + NodeIntegralOutput[k];
+                }
+            }
+        }
+
+        PhaseTimerSwitch (&Timer, PHASE_SHUTDOWN);
+
+        MPI_Barrier( MPI_COMM_WORLD ) ;
+        /* compute the time taken to compute the sum, only the last trial displays it */
+        if (ProcRank == NODE_0){
+            EndTime = std::chrono::steady_clock::now();
+            ElapsedTime = EndTime - StartTime;
+            if (Trial >= NoOfWarmups) {
+                TrialTimes[Trial - NoOfWarmups] = ElapsedTime.count();
+            }
+
+            if (Trial == NoOfWarmups + NoOfTrials - 1) {
+                for (k = 0; k < NoOfIntegrands; k++) {
+                    std::cout<<IntegralOutput[k]<<std::endl;
+                }
+            }
+        }
+
+        delete[] NodeIntegralOutput;
+        delete[] IntegralOutput;
+
+        PhaseTimerEndTrial (&Timer, Trial >= NoOfWarmups);
     }
 
-    MPI_Barrier( MPI_COMM_WORLD ) ;
-    /* compute the time taken to compute the sum and display the same */
+    /* the median time over the trials goes to stderr, the phase breakdown to stdout */
     if (ProcRank == NODE_0){
-        EndTime = std::chrono::system_clock::now();
-        ElapsedTime = EndTime - StartTime;
-
-        std::cout<<IntegralOutput[0]<<std::endl;
-        std::cerr<<ElapsedTime.count()<<std::endl;
+        std::cerr<<PhaseTimerMedian (TrialTimes, NoOfTrials)<<std::endl;
+    }
+    if (NoOfWarmups + NoOfTrials > 1) {
+        PhaseTimerReport (&Timer, MPI_COMM_WORLD, NODE_0, stdout);
     }
     MPI_Barrier( MPI_COMM_WORLD ) ;
 
-    delete[] NodeIntegralOutput;
-    delete[] IntegralOutput;
-
 
 
 EXIT: